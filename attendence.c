@@ -1,64 +1,238 @@
-#include <xc.h>
 #include <string.h> // Required for strcmp
-
-#pragma config FOSC = HS      // Oscillator Selection bits (HS oscillator)
-#pragma config WDTE = OFF     // Watchdog Timer Enable bit (WDT disabled)
-#pragma config PWRTE = ON     // Power-up Timer Enable bit (PWRT enabled)
-#pragma config CP = OFF       // FLASH Program Memory Code Protection bit (Code protection off)
-#pragma config BOREN = OFF    // Brown-out Reset Enable bit (BOR disabled)
-#pragma config LVP = OFF      // Low-Voltage (Single-Supply) In-Circuit Serial Programming Enable bit (RB3 is digital I/O, HV on MCLR must be used for programming)
-#pragma config CPD = OFF      // Data EEPROM Memory Code Protection bit (Data EEPROM code protection off)
-#pragma config WRT = OFF      // Flash Program Memory Write Enable bits (Write protection off; all program memory may be written to by EECON control)
-
-#define _XTAL_FREQ 20000000
-
-// DS1302 pin mapping
-#define DS1302_RST  RA0
-#define DS1302_IO   RA1
-#define DS1302_CLK  RA2
-
-// LCD pin mapping
-#define LCD_RS RC1
-#define LCD_RW RC0
-#define LCD_E  RC2
-#define LCD_PORT PORTD
+#include "hal.h"       // Board access (hal_pic16.c on the PIC, host/hal_host.c in the simulator)
+#include "protocol.h"  // Serial frame format shared with the host tools
+#include "directory.h" // External user directory image layout
+#include "presence.h"  // Presence table sizing (MAX_PRESENT_USERS) and RAM bank placement
 
 // --- Constants ---
-#define MAX_USERS 10
-#define MAX_PRESENT_USERS 10
 const char RESET_PIN[5] = "9988"; // Security PIN for reset
 
+// --- User Directory ---
+// 0: users_table.h (generated from roster.csv) in program memory. 1: 24LC256 on the MSSP I2C bus (RC3/RC4)
+// holding an image from tools/dir_image, with recently seen IDs cached in RAM.
+#ifndef USER_DIRECTORY_EXTERNAL
+#define USER_DIRECTORY_EXTERNAL 0
+#endif
+#define USER_TABLE_MAX_WORDS 4096 // Program memory the generated users_table.h may take (half the flash)
+#define NAME_SHOWN 8              // Name characters the screens use (and the cache keeps)
+#define DIR_CACHE_SIZE 4          // Recently seen users kept in RAM (external directory)
+
+// --- Daily User Totals ---
+// Kept in a second 24LC256 (A0 high, at 0x8000 on the HAL's external EEPROM bus), one
+// record per directory user in directory order. The event log takes the top of the chip.
+#define TOTALS_BASE 0x8000
+#define TOTALS_RECORD_SIZE 8      // [2] day [3] seconds [1] visits [2] check
+#define TOTALS_CHECK 6            // Offset of the check: CRC-16 over the roll number and the bytes before
+#define TOTALS_MAX_SECONDS 0xFFFFFFUL // Stops there (194 days; a day's visits end at the checkout)
+#define TOTALS_MAX_USERS 3072     // 24 KB: more than the ~2,900 users a directory image holds
+
+// --- Event Log ---
+// A ring on the totals 24LC256 above the totals. Records are packed seven to a 64-byte
+// page (one byte spare), so every append is a single page write.
+#define EVLOG_BASE 0xE000         // Top 8 KB of the totals chip
+#define EVLOG_RECORD_SIZE 9
+#define EVLOG_PER_PAGE 7
+#define EVLOG_PAGES 128
+#define EVLOG_SLOTS (EVLOG_PAGES * EVLOG_PER_PAGE) // 896 records: a day of 200 people in and out twice
+#define EV_ENTRY 0x80             // Record flags: direction bit (clear = exit)
+
+// --- Keypad Scanner ---
+#define KEY_QUEUE_SIZE 8          // Pending key events (must be a power of two)
+#define KEY_DEBOUNCE_TICKS 5      // Consecutive 1 ms samples needed to accept a press or release
+
+// --- Idle Sleep ---
+// After IDLE_SLEEP_MS with nothing to do the core sleeps until a key is pressed. The
+// oscillator stops, so the USART cannot receive meanwhile: a door with a polling host
+// should set this to 0 (never sleep).
+#define IDLE_SLEEP_MS 10000
+
+// --- Software Clock ---
+#define CLOCK_RESYNC_MINUTES 10   // Reload the software clock from the DS1302 this often
+
+// --- Data EEPROM ---
+#define EE_QUEUE_SIZE 32          // Pending EEPROM byte writes (must be a power of two)
+#define SNAP_BASE 0x00            // Presence snapshot
+#define SNAP_EPOCH_ADDR 0xFF      // Snapshot epoch: bumping it retires every snapshot record at once
+
+// --- End-of-Day Checkout ---
+// Everyone still inside at AUTO_CHECKOUT_HOUR:AUTO_CHECKOUT_MINUTE is checked out at that
+// time, with their durations logged and added to the totals as for a badge exit.
+// 0 turns it off.
+#define AUTO_CHECKOUT 1
+#define AUTO_CHECKOUT_HOUR 23
+#define AUTO_CHECKOUT_MINUTE 55
+#define BCD(n) ((((n) / 10) << 4) | ((n) % 10)) // Constant in packed BCD, folded by the compiler
+
+// --- UART Event Stream ---
+#define TERMINAL_ID 1             // Identifies this door to the central system
+#define UART_TX_SIZE 64           // Transmit ring (must be a power of two)
+#define LOG_DEFAULT_WINDOW 10     // Log download: records sent ahead of the ACKs when the host leaves it to us
+
+// --- Timed Screens ---
+// Result and info screens do not block: they are shown with a timeout and uiTick()
+// runs the follow-up step when it expires. Any key press cancels the pending screen
+// first, so the next person can start typing straight away.
+enum {
+    UI_NONE,          // Nothing pending, screen stays as is
+    UI_IDLE,          // Back to the welcome screen
+    UI_RESTORE_ID,    // Back to the partially typed ID
+    UI_RESTORE_PIN,   // Back to the partially typed PIN
+    UI_EXIT_DURATION, // Exit time was shown, duration comes next
+    UI_LIST_NEXT,     // Show the next present user
+    UI_LIST_MORE      // Page full, show "PRESS B FOR MORE"
+};
+
+// The presence snapshot must fit in the 256 bytes of data EEPROM
+typedef char eeprom_layout_fits[(SNAP_BASE + PRESENCE_EE_BYTES(MAX_PRESENT_USERS) <= SNAP_EPOCH_ADDR) ? 1 : -1];
+typedef char eeprom_free_matches[(PRESENCE_EE_FREE == SNAP_EPOCH_ADDR - SNAP_BASE) ? 1 : -1];
+// An exit's snapshot records (up to two moved slots and the freed one) must fit in the write queue together
+typedef char ee_queue_fits_exit[(3 * SNAP_RECORD_SIZE < EE_QUEUE_SIZE) ? 1 : -1];
+// Open addressing needs free cells to end every probe, and a power-of-two size to wrap with a mask
+typedef char presence_hash_fits[(PRESENCE_HASH_SIZE * 2 >= MAX_PRESENT_USERS * 3
+                                 && (PRESENCE_HASH_SIZE & (PRESENCE_HASH_SIZE - 1)) == 0) ? 1 : -1];
+// Slots, counts and hash cells are bytes (a cell holds slot + 1)
+typedef char presence_fits_byte[(MAX_PRESENT_USERS >= 1 && MAX_PRESENT_USERS < 255) ? 1 : -1];
+// Each presence group must fit in the RAM bank it is placed in
+typedef char presence_lookup_fits_bank[(PRESENCE_LOOKUP_BYTES(MAX_PRESENT_USERS) <= PRESENCE_BANK_BYTES) ? 1 : -1];
+typedef char presence_times_fit_bank[(PRESENCE_TIMES_BYTES(MAX_PRESENT_USERS) <= PRESENCE_BANK_BYTES) ? 1 : -1];
+// A whole event or log frame must fit in the transmit ring
+typedef char uart_fits_event[(EVENT_PAYLOAD_SIZE + PROTO_OVERHEAD < UART_TX_SIZE) ? 1 : -1];
+typedef char uart_fits_log[(LOG_RECORDS_PER_FRAME * LOG_RECORD_SIZE + PROTO_OVERHEAD < UART_TX_SIZE) ? 1 : -1];
+typedef char uart_fits_totals[(TOT_PAYLOAD_SIZE + PROTO_OVERHEAD < UART_TX_SIZE) ? 1 : -1];
+typedef char uart_fits_checkout[(CHK_RECORDS + CHK_RECORDS_PER_FRAME * CHK_RECORD_SIZE + PROTO_OVERHEAD < UART_TX_SIZE) ? 1 : -1];
+// The checkout time is a time of day
+typedef char checkout_time_valid[(AUTO_CHECKOUT_HOUR < 24 && AUTO_CHECKOUT_MINUTE < 60) ? 1 : -1];
+// Totals records are aligned, so one never straddles a 64-byte EEPROM write page
+typedef char totals_fit_page[(64 % TOTALS_RECORD_SIZE == 0) ? 1 : -1];
+// The totals end where the event log starts, and the log ends with the chip
+typedef char totals_below_log[(TOTALS_BASE + (unsigned long)TOTALS_MAX_USERS * TOTALS_RECORD_SIZE <= EVLOG_BASE) ? 1 : -1];
+typedef char evlog_fits_chip[(EVLOG_BASE + (unsigned long)EVLOG_PAGES * 64 <= 0x10000UL
+                              && EVLOG_PER_PAGE * EVLOG_RECORD_SIZE <= 64 && (EVLOG_BASE & 63) == 0) ? 1 : -1];
+// The idle timer is measured with the 16-bit tick
+typedef char idle_sleep_fits_tick[(IDLE_SLEEP_MS < 32768) ? 1 : -1];
+
 // Function prototypes
-void delay_ms(unsigned int ms);
-void delay_us(unsigned int us);
+void LCD_WaitBusy();
 void LCD_Data(unsigned char data);
 void LCD_Cmd(unsigned char cmd);
 void LCD_Init();
-void LCD_SetCursor(char row, char col);
+void LCD_Put(unsigned char row, unsigned char col, char c);
+unsigned char LCD_Print(unsigned char row, unsigned char col, const char *str);
+void LCD_Flush();
 void Send2Lcd(const char Adr, const char *Lcd);
 void clearSecondLine(); // Now essentially sends 16 spaces to 0xC0
 void clearLine1();      // Sends 16 spaces to 0x80
 void padLine(char startAddress, unsigned char writtenChars); // Helper for padding
+void showEntryLine(const char* label, const char* digits, unsigned char showCursor);
+void appInit();
+void appPoll();
 void processKey(char key);
-char* findUserName(char* rollNo);
-int getUserIndex(char* rollNo);
+unsigned int ticksNow();
+void showFor(unsigned int ms, unsigned char next);
+void uiTick();
+void runScreenStep(unsigned char step);
+void showNextPresentUser();
+void keypadScanTick();
+char keyQueueGet();
+unsigned int parseID(const char* digits);
+int searchIds(const unsigned int* ids, unsigned int count, unsigned int id);
+unsigned char lookupUser(unsigned int id, const char** name);
+int userIndex(unsigned int id);
+void dirInit();
 void resetDisplay();
-void formatTimeFromSeconds(unsigned int totalSeconds, char* timeStr);
+unsigned char formatDuration(unsigned long secs, char* out); // HH:MM:SS or "<days>d HH:MM" (up to 10 chars + null)
 void performSystemReset(); // Moved actual reset logic here
 
 // DS1302 RTC Functions
-void DS1302_Init();
-void DS1302_WriteByte(unsigned char data);
-unsigned char DS1302_ReadByte();
-void DS1302_Write(unsigned char cmd, unsigned char data);
-unsigned char DS1302_Read(unsigned char cmd);
+// Seconds since 2000-01-01 00:00:00, the DS1302's first year. 32 bits run to 2136,
+// past the RTC's own 2099, so stays of any length are one subtraction.
+typedef unsigned long Timestamp;
+
+// Time snapshot taken with one clock-burst read. The time of day stays in the DS1302's
+// packed BCD (0x59 = 59) so the clock screen needs no arithmetic; the date is decimal.
+typedef struct {
+    unsigned char sec;   // BCD
+    unsigned char min;   // BCD
+    unsigned char hour;  // BCD, 24 hr mode
+    unsigned char date;  // Day of month 1-31
+    unsigned char month; // 1-12
+    unsigned char year;  // 0-99 = 2000-2099
+    unsigned char day;   // Day of week 1-7
+    Timestamp dayBase;   // Timestamp of this date's midnight, worked out once per RTC read
+    unsigned int dayNumber; // Days since 2000-01-01, cached with dayBase (no divide by 86400)
+} ClockSnapshot;
+
 unsigned char BCD_to_Dec(unsigned char bcd);
 unsigned char Dec_to_BCD(unsigned char dec);
-void getTimeString(char* timeStr); // HH:MM:SS (8 chars + null)
-unsigned int getCurrentTimeInSeconds();
+unsigned char bcdIncrement(unsigned char bcd);
+void putBcd(unsigned char bcd, char* out); // Two ASCII digits, no terminator
+void DS1302_ReadClock(ClockSnapshot* t);
+void formatClock(const ClockSnapshot* t, char* timeStr); // HH:MM:SS (8 chars + null)
+unsigned int clockDays(unsigned char year, unsigned char month, unsigned char date);
+unsigned int clockDayOf(const ClockSnapshot* now, Timestamp time);
+Timestamp clockTimestamp(const ClockSnapshot* t);
+
+// Software clock (Timer1) functions
+void clockTick();
+void clockRead(ClockSnapshot* t);
+void clockResync();
+unsigned char formatDigits(unsigned int value, unsigned char width, char* out); // No terminator
+unsigned int ladderDivide(unsigned long* rest, unsigned long unit, unsigned char bits);
+
+// Data EEPROM functions
+unsigned char eeRead(unsigned char addr);
+unsigned char eeQueueFree();
+void eeQueueWrite(unsigned char addr, unsigned char data);
+void eeKick();
+void eeWriteNext();
+void snapshotWriteSlot(unsigned char slot);
+void snapshotRestore();
+void snapshotRepair();
+void snapshotClear();
+
+// Event log functions
+void evlogStep(unsigned int* addr, unsigned char* index);
+void evlogStepBack(unsigned int* addr, unsigned char* index, unsigned int back);
+unsigned char evlogRead(unsigned int addr, unsigned char* rec);
+void evlogInit();
+void evlogAppend(unsigned int roll, unsigned char flags, Timestamp time);
+void evlogFlush();
+void evlogPoll();
+unsigned int evlogSpan(unsigned int seq);
+unsigned int evlogOldest();
+void recordEvent(unsigned int roll, unsigned char flags, Timestamp time, unsigned long duration);
+
+// End-of-day checkout
+void checkoutPoll();
+void autoCheckout(Timestamp at);
+
+// UART functions
+unsigned char uartTxFree();
+unsigned char uartFrameBegin(unsigned char type, unsigned char maxLen);
+void uartFramePut(unsigned char data);
+void uartFrameEnd();
+unsigned char uartSendFrame(unsigned char type, const unsigned char* payload, unsigned char len);
+void uartCommand();
+void logPump();
+
+// Idle sleep
+unsigned char appIdle();
+void idleSleep();
+
+// Daily user totals
+typedef struct {
+    unsigned int day;      // Days since 2000-01-01 the totals are for (0xFFFF = no visits recorded)
+    unsigned long seconds; // Time inside over the finished visits that began that day
+    unsigned char visits;  // Finished visits (stops at 255)
+} UserTotals;
+
+unsigned int totalsCheck(unsigned int id, const unsigned char* rec);
+unsigned char totalsRead(unsigned int id, UserTotals* t, unsigned int* addr);
+void totalsAdd(unsigned int id, unsigned int day, unsigned long seconds);
+void showUserTotals(unsigned int id);
 
 // Global variables
-unsigned int peoplePresent = 0; // Count of people currently inside
+unsigned char peoplePresent = 0; // Count of people currently inside (= occupied presence slots)
 char currentID[5] = ""; // To store user ID (4 digits + null)
 unsigned int idPos = 0; // Position in ID entry
 
@@ -67,151 +241,358 @@ unsigned char pinEntryMode = 0; // 0 = Normal, 1 = Waiting for Reset PIN
 char currentPin[5] = ""; // Buffer for entered PIN
 unsigned char pinPos = 0; // Position in PIN entry
 
-// Predefined users (Roll Number to Name mapping)
+// --- UI State ---
+volatile unsigned int tickMs = 0; // Free-running 1 ms tick from Timer0
+unsigned char uiNext = UI_NONE;   // Step to run when the current screen times out
+unsigned int uiDeadline = 0;      // tickMs value at which it times out
+char uiDuration[11];              // Duration text for the UI_EXIT_DURATION step
+unsigned char listSlot = 0;       // Pager cursor: presence slot the next B page resumes from (see removeEntryTime)
+unsigned char listShown = 0;      // Users shown on this page
+unsigned char listNumber = 0;     // On-screen numbering (1, 2, 3...), carried across pages (0 = no listing open)
+Timestamp listNow = 0;            // Clock read once when the page started
+char uiScreenKey = '\0';          // Key that put the current timed screen up
+unsigned int idleSince = 0;       // tickMs when the terminal last had something to do
+
+// --- Software Clock State ---
+// Timer1 advances clockNow every second so reading the time is a RAM copy.
+// The DS1302 stays the reference: it is re-read at boot, every
+// CLOCK_RESYNC_MINUTES and at midnight (for the date). The day base is carried
+// across midnight by the ISR until that resync confirms it.
 typedef struct {
-    char rollNo[5];
-    char name[17];  // Max 16 chars for LCD display + null terminator
-} User;
-
-// Store user data in program memory instead of RAM
-const User users[MAX_USERS] = {
-    {"2301", "Aarav"},    {"2302", "Diya"},     {"2303", "Arjun"},
-    {"2304", "Ananya"},   {"2305", "Ishaan"},   {"2306", "Siya"},
-    {"2307", "Vihaan"},   {"2308", "Aanya"},    {"2309", "Advait"},
-    {"2310", "Avni"}
-};
-
-// MEMORY OPTIMIZATION: Use bit array for status (1 bit per user)
-// and separate tracking for entry times only for present users
+    int last;             // RTC minus software clock at the latest resync (seconds)
+    unsigned int maxAbs;  // Largest |drift| seen since boot
+    unsigned int resyncs; // Resyncs since boot (the boot-time load is not counted)
+} ClockDriftStats;
+
+volatile ClockSnapshot clockNow;          // Current time kept by Timer1
+volatile unsigned char clockTenths = 0;   // 100 ms steps into the current second
+volatile unsigned char clockSinceSync = 0; // Minutes since the last resync
+volatile unsigned char clockResyncDue = 1; // Set by the ISR, serviced by the main loop
+volatile unsigned char checkoutDue = 0;   // Checkout time reached (or clock reloaded): main loop checks
+Timestamp checkoutDone = 0;               // Scheduled checkout that last ran
+unsigned char clockSynced = 0;            // clockNow holds a real time
+ClockDriftStats clockDrift = {0};
+
+// --- Serial Link State ---
+unsigned char uartTxBuf[UART_TX_SIZE];
+volatile unsigned char uartTxHead = 0;   // Main loop adds at head
+volatile unsigned char uartTxTail = 0;   // ISR takes from tail
+unsigned char uartTxFrame;               // Where the frame being built starts
+unsigned char uartTxPos;                 // Where its next byte goes (published by uartFrameEnd)
+unsigned char uartFramesDropped = 0;     // Frames lost because the ring was full
+
+enum { RX_SYNC, RX_TYPE, RX_LEN, RX_PAYLOAD, RX_CRC_LO, RX_CRC_HI };
+unsigned char uartRxState = RX_SYNC;
+unsigned char uartRxType;
+unsigned char uartRxLen;
+unsigned char uartRxPos;
+unsigned int uartRxCrc;
+unsigned char uartRxPayload[PROTO_MAX_RX_PAYLOAD];
+volatile unsigned char uartRxReady = 0;  // uartRxType/uartRxPayload hold a checked frame for the main loop
+unsigned char uartRxDropped = 0;         // Frames lost (bad CRC, too long, or main loop still busy)
+
+// Log download state
+unsigned char logActive = 0;   // A download is running
+unsigned int logAddr;          // Next ring slot to send (EEPROM address)
+unsigned char logIndex;        // Its place in its page
+unsigned int logLeft;          // Slots from there up to the head
+unsigned int logSendSeq;       // Next sequence number to send
+unsigned int logAckSeq;        // Host has everything before this
+unsigned char logWindow;       // How far logSendSeq may run ahead of logAckSeq
+
+#if !USER_DIRECTORY_EXTERNAL
+// Predefined users, generated from roster.csv by tools/gen_users (the CMake build
+// regenerates it when the roster changes). Struct of arrays: userIds[] holds the
+// sorted roll numbers and userNames[] every name back to back, with an offset
+// for each block of USER_NAME_BLOCK users in userNameBlockAt[].
+#ifdef USERS_TABLE_IN_BUILD
+#include <users_table.h> // CMake: the copy regenerated in the build directory (on the include path)
+#else
+#include "users_table.h" // MPLAB: the checked-in copy next to this file
+#endif
+#else
+// --- External Directory State ---
+typedef struct {
+    unsigned int id;        // Roll number, 0 = unused
+    char name[NAME_SHOWN + 1]; // First NAME_SHOWN characters, terminated
+} DirCacheEntry;
+
+unsigned int dirCount = 0;       // Users in the image (0 = no valid image found at boot)
+unsigned int dirPages;           // Index pages
+unsigned int dirIndexAddr;       // First index page
+DirCacheEntry dirCache[DIR_CACHE_SIZE];
+unsigned char dirCacheOrder[DIR_CACHE_SIZE]; // dirCache entries, most recently used first
+#endif
+unsigned int dirLookups = 0;     // Directory statistics (read by the simulator)
+unsigned int dirHits = 0;        // Lookups answered from the RAM cache
+
+// Presence is kept per slot, not per user, so RAM follows the number of people
+// inside rather than the size of the directory.
+// Slots [0, peoplePresent) are always the occupied ones (exits move the last
+// occupant into the hole), and idSlot maps a roll number to its slot through a
+// small open-addressed hash, so entry, exit and lookup never scan.
+// The roll numbers and the hash share a bank; the entry times live in another (presence.h).
 typedef struct {
-    unsigned char statusBits[4];  // 32 bits (4 bytes) for up to 32 users' status
-    unsigned int entryTimes[MAX_PRESENT_USERS];  // Entry times for present users (Size increased)
-    unsigned char entryUserIndex[MAX_PRESENT_USERS];  // Which user each entry time belongs to (index + 1, 0=empty) (Size increased)
+    unsigned int entryIds[MAX_PRESENT_USERS];    // Roll number in each occupied slot
+    unsigned char idSlot[PRESENCE_HASH_SIZE];    // Slot + 1 of a present roll number (0 = free cell)
 } StatusTracking;
 
-StatusTracking presence = {0}; // Initialize all to zero
+HAL_BANK(PRESENCE_LOOKUP_BANK) StatusTracking presence = {0}; // Initialize all to zero
+HAL_BANK(PRESENCE_TIMES_BANK) Timestamp presenceTimes[MAX_PRESENT_USERS]; // Entry time of each occupied slot
+
+// Where a roll number's probe sequence starts
+unsigned char presenceHome(unsigned int id) {
+    return PRESENCE_HOME(id, PRESENCE_HASH_SIZE);
+}
+
+// Hash cell holding a present roll number, or PRESENCE_HASH_SIZE if they are not inside
+unsigned char presenceFind(unsigned int id) {
+    unsigned char h = presenceHome(id);
+    while (presence.idSlot[h]) {
+        if (presence.entryIds[presence.idSlot[h] - 1] == id) return h;
+        h = (h + 1) & (PRESENCE_HASH_SIZE - 1);
+    }
+    return PRESENCE_HASH_SIZE;
+}
 
-// Helper functions for bit manipulation
-void setUserPresent(unsigned char userIndex, unsigned char present) {
-    if (userIndex >= MAX_USERS) return; // Bounds check
-    unsigned char byteIndex = userIndex / 8;
-    unsigned char bitPos = userIndex % 8;
-    if(present) { presence.statusBits[byteIndex] |= (1 << bitPos); }
-    else { presence.statusBits[byteIndex] &= ~(1 << bitPos); }
+unsigned char isUserPresent(unsigned int id) {
+    return presenceFind(id) != PRESENCE_HASH_SIZE;
 }
 
-unsigned char isUserPresent(unsigned char userIndex) {
-    if (userIndex >= MAX_USERS) return 0; // Bounds check
-    unsigned char byteIndex = userIndex / 8;
-    unsigned char bitPos = userIndex % 8;
-    return (presence.statusBits[byteIndex] & (1 << bitPos)) ? 1 : 0;
+// Hash an occupied slot in (first free cell of its probe sequence)
+void presenceLink(unsigned char slot) {
+    unsigned char h = presenceHome(presence.entryIds[slot]);
+    while (presence.idSlot[h]) h = (h + 1) & (PRESENCE_HASH_SIZE - 1);
+    presence.idSlot[h] = slot + 1;
 }
 
-unsigned char addEntryTime(unsigned char userIndex, unsigned int entryTime) {
+// Take the first free slot (always the one just past the occupied range) and count the user in
+unsigned char addEntryTime(unsigned int id, Timestamp entryTime) {
     if(peoplePresent >= MAX_PRESENT_USERS) return 0; // Check against the max PRESENT users limit
-    for (unsigned char slot = 0; slot < MAX_PRESENT_USERS; slot++) {
-        if (presence.entryUserIndex[slot] == 0) {
-            presence.entryUserIndex[slot] = userIndex + 1; // Store index+1
-            presence.entryTimes[slot] = entryTime;
-            return 1; // Success
+    unsigned char slot = peoplePresent;
+    presence.entryIds[slot] = id;
+    presenceTimes[slot] = entryTime;
+    presenceLink(slot);
+    peoplePresent++;
+    snapshotWriteSlot(slot);
+    return 1; // Success
+}
+
+// Entry time of a present user, 0 if they are not inside
+Timestamp getEntryTime(unsigned int id) {
+    unsigned char h = presenceFind(id);
+    if (h == PRESENCE_HASH_SIZE) return 0;
+    return presenceTimes[presence.idSlot[h] - 1];
+}
+
+// Move the user in slot 'from' into the free slot 'to' (the copy in 'from' is left for the caller)
+void presenceMove(unsigned char from, unsigned char to) {
+    unsigned int moved = presence.entryIds[from];
+    presence.entryIds[to] = moved;
+    presenceTimes[to] = presenceTimes[from];
+    presence.idSlot[presenceFind(moved)] = to + 1;
+    snapshotWriteSlot(to);
+}
+
+// Free a present user's slot and count them out. The last occupied slot moves into
+// the hole so the occupied range stays compact. Does nothing if they are not inside.
+// While a B listing is open, slots below listSlot have been shown and the rest have
+// not. If the hole is below the cursor and the last slot is not, the user shown last
+// takes the hole and the unshown user fills theirs instead, one slot behind a cursor
+// that steps back with it, so nobody is skipped and nobody is shown twice.
+void removeEntryTime(unsigned int id) {
+    unsigned char h = presenceFind(id);
+    if (h == PRESENCE_HASH_SIZE) return;
+    unsigned char slot = presence.idSlot[h] - 1;
+
+    // Unhash: pull back later cells of the probe run that may move into the hole
+    unsigned char next = h;
+    while (1) {
+        next = (next + 1) & (PRESENCE_HASH_SIZE - 1);
+        unsigned char cell = presence.idSlot[next];
+        if (!cell) break;
+        unsigned char home = presenceHome(presence.entryIds[cell - 1]);
+        if (((next - home) & (PRESENCE_HASH_SIZE - 1)) >= ((next - h) & (PRESENCE_HASH_SIZE - 1))) {
+            presence.idSlot[h] = cell;
+            h = next;
         }
     }
-    return 0; // No empty slot found (shouldn't happen if peoplePresent is accurate)
-}
+    presence.idSlot[h] = 0;
 
-unsigned int getEntryTime(unsigned char userIndex) {
-    for(unsigned char i = 0; i < MAX_PRESENT_USERS; i++) {
-        if(presence.entryUserIndex[i] == userIndex + 1) { // Compare with index+1
-            return presence.entryTimes[i];
+    unsigned char last = --peoplePresent;
+    if (slot < listSlot && last >= listSlot) {
+        if (slot != --listSlot) {
+            presenceMove(listSlot, slot);
+            slot = listSlot;
         }
     }
-    return 0; // Not found (user isn't currently marked as present with a time)
+    if (slot != last) presenceMove(last, slot);
+    presence.entryIds[last] = 0;   // Mark slot as empty
+    presenceTimes[last] = 0; // Clear time
+    snapshotWriteSlot(last);
 }
 
-void removeEntryTime(unsigned char userIndex) {
-    for(unsigned char i = 0; i < MAX_PRESENT_USERS; i++) {
-        if(presence.entryUserIndex[i] == userIndex + 1) { // Compare with index+1
-            presence.entryUserIndex[i] = 0; // Mark slot as empty
-            presence.entryTimes[i] = 0;     // Clear time
-            return; // Found and removed
+// --- Keypad Scanner State (driven from the Timer0 interrupt) ---
+const char keyValues[4][4] = {
+    {'1', '2', '3', 'A'}, {'4', '5', '6', 'B'},
+    {'7', '8', '9', 'C'}, {'*', '0', '#', 'D'}
+};
+
+// Column nibble (RB7..RB4, active low) -> column index, 0xFF = no key or several keys
+const unsigned char colDecode[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 3,    // 0111 -> col 3
+    0xFF, 0xFF, 0xFF, 2,    0xFF, 1,    0,    0xFF  // 1011 -> col 2, 1101 -> col 1, 1110 -> col 0
+};
+
+enum { KP_IDLE, KP_DEBOUNCE, KP_HELD };
+
+volatile char keyQueue[KEY_QUEUE_SIZE]; // Ring buffer: ISR writes at head, main loop reads at tail
+volatile unsigned char keyHead = 0;
+volatile unsigned char keyTail = 0;
+volatile unsigned char keysDropped = 0; // Presses lost because the queue was full
+
+unsigned char kpRow = 0;        // Row currently driven low
+unsigned char kpState = KP_IDLE;
+unsigned char kpCount = 0;      // Debounce sample counter
+char kpKey = '\0';              // Key being debounced / held
+
+// --- Interrupt Handlers (called from the HAL's interrupt dispatch) ---
+void HAL_OnTick() { // 1 ms system tick
+    tickMs++;
+    keypadScanTick();
+}
+void HAL_OnClockTick() { clockTick(); } // 100 ms clock tick
+void HAL_OnEeDone() { eeWriteNext(); }  // Previous EEPROM byte write finished
+
+// Advance the software clock by 100 ms
+void clockTick() {
+    if (++clockTenths < 10) return;
+    clockTenths = 0;
+    if ((clockNow.sec = bcdIncrement(clockNow.sec)) < 0x60) return;
+    clockNow.sec = 0;
+    if (++clockSinceSync >= CLOCK_RESYNC_MINUTES) clockResyncDue = 1;
+    if ((clockNow.min = bcdIncrement(clockNow.min)) >= 0x60) {
+        clockNow.min = 0;
+        if ((clockNow.hour = bcdIncrement(clockNow.hour)) >= 0x24) {
+            clockNow.hour = 0;
+            clockNow.dayBase += 86400UL; // Timestamps stay right until the resync reads the new date
+            clockNow.dayNumber++;
+            clockResyncDue = 1; // New day: date and day of week come from the RTC
         }
     }
+    if (AUTO_CHECKOUT && clockNow.min == BCD(AUTO_CHECKOUT_MINUTE) && clockNow.hour == BCD(AUTO_CHECKOUT_HOUR)) {
+        checkoutDue = 1;
+    }
+}
+
+// One keypad sample per tick. While idle the driven row rotates every tick, so each
+// read sees a row that has had a full tick to settle. Once a key shows up the row is
+// held until the key has been released for KEY_DEBOUNCE_TICKS samples.
+void keypadScanTick() {
+    unsigned char col = colDecode[HAL_KeypadColumns()];
+
+    switch (kpState) {
+        case KP_IDLE:
+            if (col != 0xFF) {
+                kpKey = keyValues[kpRow][col];
+                kpCount = 1;
+                kpState = KP_DEBOUNCE;
+                return; // Keep this row driven
+            }
+            kpRow = (kpRow + 1) & 0x03;
+            HAL_KeypadSelectRow(kpRow); // Activate next row
+            break;
+
+        case KP_DEBOUNCE:
+            if (col != 0xFF && keyValues[kpRow][col] == kpKey) {
+                if (++kpCount >= KEY_DEBOUNCE_TICKS) {
+                    unsigned char next = (keyHead + 1) & (KEY_QUEUE_SIZE - 1);
+                    if (next != keyTail) { keyQueue[keyHead] = kpKey; keyHead = next; }
+                    else { keysDropped++; }
+                    kpCount = 0;
+                    kpState = KP_HELD;
+                }
+            } else {
+                kpState = KP_IDLE; // Bounce or a different key - start over
+            }
+            break;
+
+        case KP_HELD:
+            if (col == 0xFF) {
+                if (++kpCount >= KEY_DEBOUNCE_TICKS) kpState = KP_IDLE; // Released
+            } else {
+                kpCount = 0; // Still down (or bouncing)
+            }
+            break;
+    }
 }
 
-// --- Interrupt Service Routine (Placeholder) ---
-void __interrupt() isr() {
-    GIE = 0; // Disable interrupts during ISR (Good practice)
-    // Add interrupt flag checks and handlers here if needed
-    // Example: if(PIR1bits.TMR1IF) { /* handle timer1 */ PIR1bits.TMR1IF = 0; }
-    GIE = 1; // Re-enable interrupts before exiting if required by application logic
+// Read the 1 ms tick counter (16 bits, so mask the tick while copying it)
+unsigned int ticksNow() {
+    HAL_TickIrq(0);
+    unsigned int now = tickMs;
+    HAL_TickIrq(1);
+    return now;
 }
 
-void main()
-{
-    char keyValues[4][4] = {
-        {'1', '2', '3', 'A'}, {'4', '5', '6', 'B'},
-        {'7', '8', '9', 'C'}, {'*', '0', '#', 'D'}
-    };
-
-    // --- Port Initialization ---
-    TRISA = 0x02;  // RA1 (DS1302_IO) needs input capability. Others output.
-    TRISC = 0x00;  // PORTC (LCD Control) -> Output
-    TRISD = 0x00;  // PORTD (LCD Data) -> Output
-    TRISB = 0xF0;  // RB7-RB4 (Keypad Cols) -> Input, RB3-RB0 (Keypad Rows) -> Output
-
-    // --- Peripheral Setup ---
-    ADCON1 = 0x06; // Configure PORTA pins as digital I/O on PIC16F877A
-    OPTION_REGbits.nRBPU = 0; // Enable PORTB pull-ups for keypad columns
-
-    // --- Module Initialization ---
+// Pop the oldest queued key, or '\0' if none is waiting
+char keyQueueGet() {
+    if (keyTail == keyHead) return '\0';
+    char key = keyQueue[keyTail];
+    keyTail = (keyTail + 1) & (KEY_QUEUE_SIZE - 1);
+    return key;
+}
+
+// Bring the terminal up: hardware, restored state, clock and the welcome screen
+void appInit() {
+    HAL_Init();
     LCD_Init();
-    DS1302_Init();
+    dirInit(); // Directory header (external EEPROM builds)
+
+    // --- Data EEPROM: restore who was inside and find the log head before writes start ---
+    snapshotRestore();
+    evlogInit();
+
+    HAL_StartInterrupts(); // 1 ms tick, 100 ms clock tick, EEPROM completion
+
+    snapshotRepair(); // Only writes anything if the restore had to repack slots
+
+    clockResync(); // Load the software clock from the DS1302
 
     resetDisplay(); // Show the initial welcome screen
+    LCD_Flush();
+}
+
+// One pass of the main loop
+void appPoll() {
+    // Keys are scanned and debounced in the ISR; just drain the queue here
+    char key = keyQueueGet();
+    if(key != '\0') {
+        processKey(key);
+    }
+    if (clockResyncDue) clockResync();
+    if (checkoutDue) checkoutPoll();
+    if (uartRxReady) uartCommand(); // Frame from the central system
+    evlogPoll(); // Write a waiting log record once the totals chip is free
+    logPump();   // Keep a log download going while the transmit ring has room
+    uiTick();    // Expire timed screens
+    LCD_Flush(); // Send whatever changed on screen (nothing if clean)
+
+    if (!appIdle()) idleSince = ticksNow();
+    else if (IDLE_SLEEP_MS && (unsigned int)(ticksNow() - idleSince) >= IDLE_SLEEP_MS) idleSleep();
+}
+
+#ifndef HAL_HOST // The simulator provides its own main() and drives appPoll() in virtual time
+void main()
+{
+    appInit();
     // --- Main Loop ---
     while(1)
     {
-        char key = '\0'; // Store detected key press
-
-        // Keypad Scanning Logic (Row by Row) - Standard polling
-        PORTB = 0b11111110; // Activate Row 0 (RB0=0)
-        if (RB4 == 0) { key = keyValues[0][0]; while(RB4==0); }
-        else if (RB5 == 0) { key = keyValues[0][1]; while(RB5==0); }
-        else if (RB6 == 0) { key = keyValues[0][2]; while(RB6==0); }
-        else if (RB7 == 0) { key = keyValues[0][3]; while(RB7==0); }
-
-        if(key == '\0') {
-            PORTB = 0b11111101; // Activate Row 1 (RB1=0)
-            if (RB4 == 0) { key = keyValues[1][0]; while(RB4==0); }
-            else if (RB5 == 0) { key = keyValues[1][1]; while(RB5==0); }
-            else if (RB6 == 0) { key = keyValues[1][2]; while(RB6==0); }
-            else if (RB7 == 0) { key = keyValues[1][3]; while(RB7==0); }
-        }
-
-        if(key == '\0') {
-            PORTB = 0b11111011; // Activate Row 2 (RB2=0)
-            if (RB4 == 0) { key = keyValues[2][0]; while(RB4==0); }
-            else if (RB5 == 0) { key = keyValues[2][1]; while(RB5==0); }
-            else if (RB6 == 0) { key = keyValues[2][2]; while(RB6==0); }
-            else if (RB7 == 0) { key = keyValues[2][3]; while(RB7==0); }
-        }
-
-        if(key == '\0') {
-            PORTB = 0b11110111; // Activate Row 3 (RB3=0)
-            if (RB4 == 0) { key = keyValues[3][0]; while(RB4==0); }
-            else if (RB5 == 0) { key = keyValues[3][1]; while(RB5==0); }
-            else if (RB6 == 0) { key = keyValues[3][2]; while(RB6==0); }
-            else if (RB7 == 0) { key = keyValues[3][3]; while(RB7==0); }
-        }
-
-        // Process detected key press
-        if(key != '\0') {
-            processKey(key);
-            delay_ms(150); // Debounce/delay after processing a key
-        }
-         delay_ms(20); // Small delay between scans to reduce resource usage
+        appPoll();
     }
 }
+#endif
 
 // Restore default display, ensuring lines are padded/cleared
 void resetDisplay() {
@@ -222,22 +603,91 @@ void resetDisplay() {
     pinEntryMode = 0; // Exit PIN entry mode if active
     pinPos = 0;
     currentPin[0] = '\0'; // Clear internal PIN buffer
+    uiNext = UI_NONE; // Nothing pending once we are back at the welcome screen
+    uiScreenKey = '\0';
 }
 
 // Helper to pad the rest of a line with spaces
 void padLine(char startAddress, unsigned char writtenChars) {
-    char currentPos = startAddress + writtenChars;
-    // Calculate end position based on line (0x80-0x8F for line 1, 0xC0-0xCF for line 2)
-    char endPos = (startAddress < 0xC0) ? (0x80 + 16) : (0xC0 + 16);
-    while (currentPos < endPos) {
-        LCD_SetCursor(0, currentPos); // Use SetCursor for simplicity here
-        LCD_Data(' ');
-        currentPos++;
+    unsigned char row = (startAddress & 0x40) ? 1 : 0; // 0x80-0x8F line 1, 0xC0-0xCF line 2
+    for (unsigned char col = (startAddress & 0x0F) + writtenChars; col < 16; col++) {
+        LCD_Put(row, col, ' ');
+    }
+}
+
+// Draw "<label><digits>_" on line 2, as used by the ID and PIN prompts
+void showEntryLine(const char* label, const char* digits, unsigned char showCursor) {
+    unsigned char col = LCD_Print(1, 0, label);
+    col = LCD_Print(1, col, digits);
+    if (showCursor) LCD_Put(1, col++, '_');
+    padLine(0xC0, col);
+}
+
+// Push a timed screen: keep what is on the LCD for ms milliseconds, then run step next
+void showFor(unsigned int ms, unsigned char next) {
+    uiDeadline = ticksNow() + ms;
+    uiNext = next;
+}
+
+// Called from the main loop: runs the pending step once its screen has timed out
+void uiTick() {
+    if (uiNext == UI_NONE) return;
+    if ((int)(ticksNow() - uiDeadline) < 0) return; // Still showing
+    unsigned char step = uiNext;
+    uiNext = UI_NONE;
+    runScreenStep(step);
+}
+
+// Follow-up actions for timed screens
+void runScreenStep(unsigned char step) {
+    switch (step) {
+        case UI_IDLE:
+            resetDisplay();
+            break;
+        case UI_RESTORE_ID: // Restore previous partial entry screen
+            Send2Lcd(0x80, " ACCESS SYSTEM  ");
+            showEntryLine("ID: ", currentID, 1);
+            break;
+        case UI_RESTORE_PIN: // Restore PIN entry prompt
+            Send2Lcd(0x80, "ENTER RESET PIN:");
+            showEntryLine("PIN: ", currentPin, 1);
+            break;
+        case UI_EXIT_DURATION: // Display: "DUR: HH:MM:SS   " or "DUR: 2d 07:45   "
+            Send2Lcd(0xC0, "DUR: ");          // 5 Chars
+            padLine(0xC0, LCD_Print(1, 5, uiDuration)); // 8-10 Chars, pad the rest
+            showFor(1500, UI_IDLE);
+            break;
+        case UI_LIST_NEXT:
+            showNextPresentUser();
+            break;
+        case UI_LIST_MORE: {
+            Send2Lcd(0x80, "PRESS B FOR MORE"); // 16 Chars
+            // Show total count on second line: "INSIDE: N    "
+            char countStr[3];
+            unsigned char countLen = formatDigits(peoplePresent, 1, countStr);
+            countStr[countLen] = '\0';
+            Send2Lcd(0xC0, "INSIDE: ");
+            Send2Lcd(0xC8, countStr);
+            padLine(0xC0, 8 + countLen);
+            showFor(1500, UI_IDLE);
+            break;
+        }
     }
 }
 
 // Process keypad input with enhanced visuals, padding, and PIN mode
 void processKey(char key) {
+    char screenKey = uiScreenKey; // Which key's screen was up before this one
+
+    // --- A key cancels whatever timed screen is still up ---
+    if (uiNext != UI_NONE) {
+        unsigned char pending = uiNext;
+        uiNext = UI_NONE;
+        if (pending == UI_RESTORE_ID || pending == UI_RESTORE_PIN) runScreenStep(pending);
+        else resetDisplay();
+        if (key == '#' || key == '*') return; // These only dismiss the message
+    }
+
     // --- Digit Entry (0-9) ---
     if(key >= '0' && key <= '9') {
         if (pinEntryMode) { // --- PIN Entry Mode ---
@@ -245,34 +695,14 @@ void processKey(char key) {
                 currentPin[pinPos++] = key;
                 currentPin[pinPos] = '\0';
 
-                // Display: "PIN: 123_"
-                LCD_Cmd(0xC0); // Go to start of line 2
-                LCD_Data('P'); LCD_Data('I'); LCD_Data('N'); LCD_Data(':'); LCD_Data(' '); // "PIN: "
-                unsigned char charsWritten = 5;
-                for(unsigned char i=0; i<pinPos; i++) { LCD_Data(currentPin[i]); charsWritten++; } // Display digits
-
-                if(pinPos < 4) {
-                    LCD_Data('_'); // Show cursor
-                    charsWritten++;
-                }
-                padLine(0xC0, charsWritten); // Pad rest of line 2
+                showEntryLine("PIN: ", currentPin, pinPos < 4); // Display: "PIN: 123_"
             }
         } else { // --- Normal ID Entry Mode ---
             if(idPos < 4) {
                 currentID[idPos++] = key;
                 currentID[idPos] = '\0'; // Null terminate
 
-                // Display: "ID: 123_"
-                LCD_Cmd(0xC0); // Go to start of line 2
-                LCD_Data('I'); LCD_Data('D'); LCD_Data(':'); LCD_Data(' '); // "ID: "
-                unsigned char charsWritten = 4;
-                for(unsigned char i=0; i<idPos; i++) { LCD_Data(currentID[i]); charsWritten++; } // Display digits
-
-                if(idPos < 4) {
-                    LCD_Data('_'); // Show cursor
-                    charsWritten++;
-                }
-                padLine(0xC0, charsWritten); // Pad rest of line 2
+                showEntryLine("ID: ", currentID, idPos < 4); // Display: "ID: 123_"
             }
             // Ignore digits if 4 already entered
         }
@@ -292,123 +722,88 @@ void processKey(char key) {
 
                 if (match) {
                     // PIN Correct - Perform Reset
-                    performSystemReset(); // Calls resetDisplay at the end
+                    performSystemReset();
                 } else {
                     // PIN Incorrect
                     Send2Lcd(0x80, "   RESET DENIED "); // 16 Chars
                     Send2Lcd(0xC0, "  INVALID PIN!  "); // 16 Chars
-                    delay_ms(1500);
-                    resetDisplay(); // Go back to initial state
+                    showFor(1500, UI_IDLE); // Go back to initial state
                 }
             } else { // Incomplete PIN
                 Send2Lcd(0x80, "    ERROR!      ");
                 Send2Lcd(0xC0, " ENTER 4 DIGITS ");
-                delay_ms(1000);
-                 // Restore PIN entry prompt
-                Send2Lcd(0x80, "ENTER RESET PIN:");
-                LCD_Cmd(0xC0); LCD_Data('P'); LCD_Data('I'); LCD_Data('N'); LCD_Data(':'); LCD_Data(' ');
-                unsigned char charsWritten = 5;
-                for(unsigned char i=0; i<pinPos; i++) { LCD_Data(currentPin[i]); charsWritten++; }
-                LCD_Data('_'); charsWritten++;
-                padLine(0xC0, charsWritten);
+                showFor(1000, UI_RESTORE_PIN);
             }
 
         } else { // --- Submit ID ---
             if(idPos == 4) { // Process only if 4 digits entered
-                char* userName = findUserName(currentID);
-
-                if(userName[0] != 'U' || userName[1] != 'n') { // Check if user is known (basic check)
-                    // Indicate processing
-                    Send2Lcd(0x80, "  PROCESSING... "); // 16 Chars
-                    Send2Lcd(0xC0, "                "); // Clear line 2
-                    delay_ms(300); // Short delay
+                unsigned int id = parseID(currentID);
+                const char* userName;
 
+                if(lookupUser(id, &userName)) { // Known user
                     // Line 1: Display "ID: XXXX NamePart"
-                    LCD_Cmd(0x80);
-                    LCD_Data('I'); LCD_Data('D'); LCD_Data(':'); LCD_Data(' '); // "ID: "
-                    for(int i=0; i<4; i++) { LCD_Data(currentID[i]); } // "ID: 1234"
-                    LCD_Data(' '); // Space after ID
-                    unsigned char line1Chars = 10; // Chars written so far: "ID: 1234 "
+                    Send2Lcd(0x80, "ID: ");
+                    Send2Lcd(0x84, currentID); // "ID: 1234"
+                    LCD_Put(0, 8, ' ');        // Space after ID
+                    unsigned char line1Chars = 9; // Chars written so far: "ID: 1234 "
 
                     // Display first part of name (up to 6 chars to fit)
                     for(int i = 0; i < 6 && userName[i] != '\0'; i++) {
-                        LCD_Data(userName[i]);
-                        line1Chars++;
+                        LCD_Put(0, line1Chars++, userName[i]);
                     }
                     padLine(0x80, line1Chars); // Pad rest of line 1
 
 
                     // Line 2: Process Entry/Exit
-                    int userIndex = getUserIndex(currentID); // Should be >= 0 here
+                    // One clock read, so the displayed and stored times are the same instant
+                    ClockSnapshot now;
+                    clockRead(&now);
                     char timeStr[9];
-                    getTimeString(timeStr); // Get HH:MM:SS
-                    unsigned int currentTime = getCurrentTimeInSeconds();
-
-                    if (userIndex != -1) { // Double check index validity
-                        if(!isUserPresent(userIndex)) { // --- Process Entry ---
-                            if (peoplePresent < MAX_PRESENT_USERS) { // Check against new limit
-                                setUserPresent(userIndex, 1);
-                                addEntryTime(userIndex, currentTime);
-                                peoplePresent++;
-                                // Display: "ENTRY: HH:MM:SS"
-                                Send2Lcd(0xC0, "ENTRY: ");       // 7 Chars
-                                Send2Lcd(0xC7, timeStr);       // 8 Chars (HH:MM:SS)
-                                padLine(0xC0, 7 + 8);          // Pad rest (1 char)
-                            } else {
-                                Send2Lcd(0xC0, " ACCESS DENIED! "); // 16 Chars
-                                Send2Lcd(0x80, " MAXIMUM INSIDE "); // Update line 1 too
-                            }
-                        } else { // --- Process Exit ---
-                            setUserPresent(userIndex, 0);
-                            unsigned int entryTime = getEntryTime(userIndex);
-                            removeEntryTime(userIndex); // Remove before decrementing count
-                            if (peoplePresent > 0) peoplePresent--;
-
-                            // Calculate time spent
-                            unsigned int timeSpent;
-                            // Handle midnight rollover
-                            if (currentTime < entryTime) { timeSpent = (86400u - entryTime) + currentTime; }
-                            else { timeSpent = currentTime - entryTime; }
-
-                            // Display: "EXIT: HH:MM:SS "
-                            Send2Lcd(0xC0, "EXIT: ");         // 6 Chars
-                            Send2Lcd(0xC6, timeStr);         // 8 Chars (HH:MM:SS)
-                            padLine(0xC0, 6 + 8);            // Pad rest (2 chars)
-                            delay_ms(1000); // Show exit time
-
-                            // Display: "DUR: HH:MM:SS   "
-                            char durationStr[9];
-                            formatTimeFromSeconds(timeSpent, durationStr);
-                            Send2Lcd(0xC0, "DUR: ");          // 5 Chars
-                            Send2Lcd(0xC5, durationStr);     // 8 Chars (HH:MM:SS)
-                            padLine(0xC0, 5 + 8);            // Pad rest (3 chars)
+                    formatClock(&now, timeStr); // Get HH:MM:SS
+                    Timestamp currentTime = clockTimestamp(&now);
+
+                    if(!isUserPresent(id)) { // --- Process Entry ---
+                        if (peoplePresent < MAX_PRESENT_USERS) { // Check against new limit
+                            addEntryTime(id, currentTime); // Also counts the user in
+                            recordEvent(id, EV_ENTRY, currentTime, 0);
+                            // Display: "ENTRY: HH:MM:SS"
+                            Send2Lcd(0xC0, "ENTRY: ");       // 7 Chars
+                            Send2Lcd(0xC7, timeStr);       // 8 Chars (HH:MM:SS)
+                            padLine(0xC0, 7 + 8);          // Pad rest (1 char)
+                        } else {
+                            Send2Lcd(0xC0, " ACCESS DENIED! "); // 16 Chars
+                            Send2Lcd(0x80, " MAXIMUM INSIDE "); // Update line 1 too
                         }
-                        delay_ms(1500); // Display result (Entry/Exit/Duration) longer
-                    } else {
-                         // This case should technically not happen if findUserName worked, but good practice
-                        Send2Lcd(0x80, "   SYSTEM ERROR ");
-                        Send2Lcd(0xC0, "  USER IDX FAIL ");
-                        delay_ms(1500);
+                        showFor(1500, UI_IDLE); // Display result longer
+                    } else { // --- Process Exit ---
+                        Timestamp entryTime = getEntryTime(id);
+                        removeEntryTime(id); // Also counts the user out
+
+                        // Time spent, across any number of midnights (0 if the clock was set back past the entry)
+                        unsigned long timeSpent = (currentTime > entryTime) ? currentTime - entryTime : 0;
+                        recordEvent(id, 0, currentTime, timeSpent);
+                        totalsAdd(id, clockDayOf(&now, entryTime), timeSpent);
+
+                        // Display: "EXIT: HH:MM:SS ", duration follows as the next step
+                        Send2Lcd(0xC0, "EXIT: ");         // 6 Chars
+                        Send2Lcd(0xC6, timeStr);         // 8 Chars (HH:MM:SS)
+                        padLine(0xC0, 6 + 8);            // Pad rest (2 chars)
+                        formatDuration(timeSpent, uiDuration);
+                        showFor(1000, UI_EXIT_DURATION); // Show exit time
                     }
                 } else { // --- Invalid ID Entered ---
                     Send2Lcd(0x80, "    ERROR!      "); // 16 Chars Centered
                     Send2Lcd(0xC0, "  INVALID ID    "); // 16 Chars Centered
-                    delay_ms(1000);
+                    showFor(1000, UI_IDLE);
                 }
-                resetDisplay(); // Reset for next input after processing or error
+                // The ID is consumed; the result stays up until it times out or the next key
+                idPos = 0;
+                currentID[0] = '\0';
 
             } else { // --- Incomplete ID Entered ---
                 Send2Lcd(0x80, "    ERROR!      "); // 16 Chars Centered
                 Send2Lcd(0xC0, " ENTER 4 DIGITS "); // 16 Chars Centered
-                delay_ms(1000);
-
-                // Restore previous partial entry screen
-                Send2Lcd(0x80, " ACCESS SYSTEM  "); // Restore line 1
-                LCD_Cmd(0xC0); LCD_Data('I'); LCD_Data('D'); LCD_Data(':'); LCD_Data(' ');
-                unsigned char charsWritten = 4;
-                for(unsigned char i=0; i<idPos; i++) { LCD_Data(currentID[i]); charsWritten++; }
-                LCD_Data('_'); charsWritten++;
-                padLine(0xC0, charsWritten);
+                showFor(1000, UI_RESTORE_ID);
             }
         } // End ID submit
     }
@@ -426,148 +821,87 @@ void processKey(char key) {
     else if(key == 'A') {
         if (pinEntryMode) return; // Ignore during PIN entry
 
+        if (idPos == 4) { // After a typed ID: that user's totals for today
+            showUserTotals(parseID(currentID));
+            idPos = 0;
+            currentID[0] = '\0';
+            return;
+        }
+
+        ClockSnapshot now;
+        clockRead(&now);
         char timeStr[9];
-        getTimeString(timeStr);
+        formatClock(&now, timeStr);
         Send2Lcd(0x80, "TIME: ");         // 6 Chars
         Send2Lcd(0x86, timeStr);         // 8 Chars (HH:MM:SS)
         padLine(0x80, 6 + 8);            // Pad rest (2 chars)
 
-        // Convert count to string (Handles up to 99, as MAX_PRESENT_USERS is 30)
-        char countStr[3]; // NN + null
-        unsigned char countLen = 0;
-        if (peoplePresent == 0) { countStr[0] = '0'; countLen = 1; }
-        else if (peoplePresent < 10) { countStr[0] = peoplePresent + '0'; countLen = 1; }
-        else { // 10-30
-            countStr[0] = (peoplePresent / 10) + '0';
-            countStr[1] = (peoplePresent % 10) + '0';
-            countLen = 2;
-        }
+        char countStr[3]; // NN + null (MAX_PRESENT_USERS is under 100)
+        unsigned char countLen = formatDigits(peoplePresent, 1, countStr);
         countStr[countLen] = '\0';
 
         Send2Lcd(0xC0, "INSIDE: ");       // 8 Chars
         Send2Lcd(0xC8, countStr);        // 1 or 2 Chars
         padLine(0xC0, 8 + countLen);     // Pad rest
-        delay_ms(1500); // Display info longer
-        resetDisplay();
+        showFor(1500, UI_IDLE); // Display info longer
     }
     // --- List Key (B) ---
     else if(key == 'B') {
         if (pinEntryMode) return; // Ignore during PIN entry
 
-        unsigned char shownCount = 0;
-        unsigned char firstFound = 0;
-        unsigned char displayIndex = 0; // Index for numbering on screen (1, 2, 3...)
-
-        for(int i = 0; i < MAX_USERS; i++) {
-            if(isUserPresent(i)) {
-                 if (!firstFound) { // Display header only once
-                     Send2Lcd(0x80, "PRESENT USERS:  "); // 16 Chars
-                     Send2Lcd(0xC0, "                "); // Clear line 2
-                     firstFound = 1;
-                     delay_ms(500); // Brief pause on header
-                 }
-                 displayIndex++;
-
-                // --- Get User Data ---
-                char rollNo[5];
-                for(int j = 0; j < 4; j++) { rollNo[j] = users[i].rollNo[j]; }
-                rollNo[4] = '\0';
-
-                char name[17];
-                for(int j = 0; j < 16; j++) { name[j] = users[i].name[j]; if(name[j] == '\0') break; }
-                name[16] = '\0';
-
-                // --- Display Part 1: "N: 2301 NamePart" ---
-                LCD_Cmd(0x80);
-                // Handle index display (up to 2 digits needed now)
-                char indexStr[3]; unsigned char indexLen = 0;
-                if (displayIndex < 10) { indexStr[0] = displayIndex + '0'; indexLen=1; }
-                else { indexStr[0] = (displayIndex / 10) + '0'; indexStr[1] = (displayIndex % 10) + '0'; indexLen=2;}
-                indexStr[indexLen] = '\0';
-                for(int k=0; k<indexLen; k++) { LCD_Data(indexStr[k]); } // N or NN
-                LCD_Data(':'); LCD_Data(' '); // ": "
-                unsigned char line1Chars = indexLen + 2;
-
-                for(int j=0; j<4; j++) { LCD_Data(rollNo[j]); } // "N: 1234"
-                line1Chars += 4;
-                LCD_Data(' '); // Space
-                line1Chars++;
-
-                // Display first part of name (adjust chars based on index len)
-                unsigned char nameMaxChars = 16 - line1Chars;
-                for(int j = 0; j < nameMaxChars && name[j] != '\0'; j++) {
-                    LCD_Data(name[j]);
-                    line1Chars++;
-                }
-                padLine(0x80, line1Chars); // Pad rest of line 1
-
-                 // --- Display Part 2: "TIME: HH:MM:SS " ---
-                 unsigned int currentTime = getCurrentTimeInSeconds();
-                 unsigned int entryTime = getEntryTime(i);
-                 unsigned int timeElapsed;
-                 if (entryTime == 0 && !isUserPresent(i)) { // Should not happen, but safety
-                    timeElapsed = 0;
-                 } else if (currentTime < entryTime) { // Handle midnight rollover
-                    timeElapsed = (86400u - entryTime) + currentTime;
-                 } else {
-                     timeElapsed = currentTime - entryTime;
-                 }
-                 char durationStr[9];
-                 formatTimeFromSeconds(timeElapsed, durationStr);
-
-                 Send2Lcd(0xC0, "TIME: ");         // 6 Chars
-                 Send2Lcd(0xC6, durationStr);     // 8 Chars
-                 padLine(0xC0, 6 + 8);            // Pad rest (2 chars)
-
-                 delay_ms(2000); // Pause to show current user's info (ID/Name + Time)
-
-                 shownCount++; // Increment count of users actually displayed in this pass
-
-                 // --- Check if need to prompt for more ---
-                 // Display up to ~5 at a time before prompting (adjust as needed)
-                 if(shownCount >= 5 && displayIndex < peoplePresent) {
-                     Send2Lcd(0x80, "PRESS B FOR MORE"); // 16 Chars
-
-                     // Show total count on second line: "INSIDE: N    "
-                      char countStr[3]; unsigned char countLen = 0;
-                      if (peoplePresent < 10) { countStr[0] = peoplePresent + '0'; countLen = 1; }
-                      else { countStr[0] = (peoplePresent / 10) + '0'; countStr[1] = (peoplePresent % 10) + '0'; countLen = 2; }
-                      countStr[countLen] = '\0';
-                      Send2Lcd(0xC0, "INSIDE: ");
-                      Send2Lcd(0xC8, countStr);
-                      padLine(0xC0, 8 + countLen);
-
-                     delay_ms(1500);
-                     goto endListDisplay_B; // Exit loop cleanly after prompt
-                 }
-             } // End if(isUserPresent)
-         } // End for loop
-
-         // --- After Loop: Handle cases ---
-         if (displayIndex == 0) { // No users found inside
-             Send2Lcd(0x80, "STATUS:         "); // 16 Chars
-             Send2Lcd(0xC0, "NO USERS INSIDE "); // 16 Chars
-             delay_ms(1500);
-         } else if (shownCount < 5) { // Only needed if we showed all users and it was less than 5
-             delay_ms(500); // Brief pause after showing the last user if list is short
-         }
-
-     endListDisplay_B: // Label to jump to after prompt or finishing list
-         resetDisplay();
-
+        listShown = 0;
+        if (peoplePresent == 0) { // No users found inside
+            listSlot = 0;
+            listNumber = 0;
+            Send2Lcd(0x80, "STATUS:         "); // 16 Chars
+            Send2Lcd(0xC0, "NO USERS INSIDE "); // 16 Chars
+            showFor(1500, UI_IDLE);
+        } else {
+            ClockSnapshot now;
+            clockRead(&now); // One clock read serves the whole page
+            listNow = clockTimestamp(&now);
+            if (listNumber == 0) { // New listing: header first
+                Send2Lcd(0x80, "PRESENT USERS:  "); // 16 Chars
+                Send2Lcd(0xC0, "                "); // Clear line 2
+                showFor(500, UI_LIST_NEXT); // Brief pause on header
+            } else { // Resume where the last page stopped
+                runScreenStep(UI_LIST_NEXT);
+            }
+        }
     }
     // --- Time Key (C) ---
     else if(key == 'C') {
         if (pinEntryMode) return; // Ignore during PIN entry
 
+        if (screenKey == 'C') { // C again while the time is up: clock drift statistics
+            char num[6];
+            unsigned char col = LCD_Print(0, 0, "RESYNCS: ");
+            num[formatDigits(clockDrift.resyncs, 1, num)] = '\0';
+            padLine(0x80, LCD_Print(0, col, num));
+
+            // "DRIFT:+1 MAX:3"
+            col = LCD_Print(1, 0, "DRIFT:");
+            int last = clockDrift.last;
+            LCD_Put(1, col++, (last < 0) ? '-' : '+');
+            num[formatDigits((unsigned int)((last < 0) ? -last : last), 1, num)] = '\0';
+            col = LCD_Print(1, col, num);
+            col = LCD_Print(1, col, " MAX:");
+            num[formatDigits(clockDrift.maxAbs, 1, num)] = '\0';
+            padLine(0xC0, LCD_Print(1, col, num));
+            showFor(2000, UI_IDLE);
+            return;
+        }
+
+        ClockSnapshot now;
+        clockRead(&now);
         char timeStr[9];
-        getTimeString(timeStr);
+        formatClock(&now, timeStr);
         Send2Lcd(0x80, " CURRENT TIME:  "); // 16 Chars
         Send2Lcd(0xC0, "   "); // Pad left (3 spaces)
         Send2Lcd(0xC3, timeStr); // HH:MM:SS (8 chars) at col 3
         padLine(0xC0, 3 + 8);    // Pad rest (5 chars)
-        delay_ms(2000); // Show time longer
-        resetDisplay();
+        showFor(2000, UI_IDLE); // Show time longer
+        uiScreenKey = 'C';
     }
     // --- Reset Key (D) ---
     else if(key == 'D') {
@@ -589,209 +923,1013 @@ void processKey(char key) {
     }
 }
 
+// Show the next present user of the B list, one screen per user
+void showNextPresentUser() {
+    if (listSlot >= peoplePresent) { // Everyone past the cursor left since the last page: start over
+        listNumber = 0;
+        listSlot = 0;
+        if (peoplePresent == 0) { // Nobody left inside
+            resetDisplay();
+            return;
+        }
+    }
+    unsigned char slot = listSlot;
+    listNumber++;
+
+    // --- Display Part 1: "N: 2301 NamePart" ---
+    char indexStr[3]; // Up to 2 digits
+    indexStr[formatDigits(listNumber, 1, indexStr)] = '\0';
+    char roll[5]; // 4 digits with leading zeros, as typed on the keypad
+    roll[formatDigits(presence.entryIds[slot], 4, roll)] = '\0';
+    unsigned char line1Chars = LCD_Print(0, 0, indexStr); // N or NN
+    line1Chars = LCD_Print(0, line1Chars, ": ");
+    line1Chars = LCD_Print(0, line1Chars, roll); // "N: 1234"
+    LCD_Put(0, line1Chars++, ' '); // Space
+
+    // Display first part of name (whatever fits after the index and ID)
+    const char* name;
+    if (!lookupUser(presence.entryIds[slot], &name)) name = ""; // Dropped from the directory while inside
+    padLine(0x80, LCD_Print(0, line1Chars, name)); // Clipped at the end of the line, pad the rest
+
+    // --- Display Part 2: "TIME: HH:MM:SS " or "TIME: 2d 07:45  " ---
+    Timestamp entryTime = presenceTimes[slot];
+    char durationStr[11];
+    formatDuration((listNow > entryTime) ? listNow - entryTime : 0, durationStr);
+
+    Send2Lcd(0xC0, "TIME: ");         // 6 Chars
+    padLine(0xC0, LCD_Print(1, 6, durationStr)); // 8-10 Chars, pad the rest
+
+    listShown++;
+    if (++slot >= peoplePresent) { // Last one: the next B starts a fresh listing
+        listSlot = 0;
+        listNumber = 0;
+        showFor(2000, UI_IDLE);
+        return;
+    }
+    listSlot = slot;
+    // Display up to ~5 at a time before prompting (adjust as needed)
+    if (listShown >= 5) showFor(2000, UI_LIST_MORE);
+    else showFor(2000, UI_LIST_NEXT); // Pause to show current user's info (ID/Name + Time)
+}
+
 // --- Actual System Reset Logic ---
+// Forget everyone inside without logging exits. The same work however many people
+// were inside: the tables are cleared whole and one EEPROM byte retires the snapshot.
 void performSystemReset() {
+    memset(&presence, 0, sizeof(presence));
+    memset(presenceTimes, 0, sizeof(presenceTimes));
+    peoplePresent = 0;
+    listSlot = 0;
+    listNumber = 0;
+    snapshotClear();
+    pinEntryMode = 0;
+    pinPos = 0;
+    currentPin[0] = '\0';
+
     Send2Lcd(0x80, " SYSTEM RESET   "); // 16 Chars
-    Send2Lcd(0xC0, "PLEASE WAIT...  "); // 16 Chars
+    Send2Lcd(0xC0, "   COMPLETE     "); // 16 Chars
+    showFor(1000, UI_IDLE); // Back in service at once; any key dismisses this
+}
 
-    // Visual progress (optional but nice)
-    delay_ms(500);
-    LCD_Cmd(0xC0); // Go to start of line 2
-    for(int i = 0; i < 16; i++) {
-        LCD_Data('*');
-        delay_ms(80); // Slow progress bar
-    }
+// ------------------ DS1302 Functions ------------------
+// Read seconds through day-of-week in a single clock-burst transaction (0xBF).
+// The DS1302 latches all time registers when the burst starts, so the fields
+// can never straddle a rollover.
+void DS1302_ReadClock(ClockSnapshot* t) {
+    unsigned char raw[7]; // sec, min, hour, date, month, day, year
+    HAL_RtcReadBurst(0xBF, raw, sizeof(raw)); // Clock burst read, stopped after the year
+    t->sec  = raw[0] & 0x7F; // Mask CH bit; the time of day is kept as BCD
+    t->min  = raw[1] & 0x7F;
+    t->hour = raw[2] & 0x3F; // Assuming 24hr mode
+    t->date = BCD_to_Dec(raw[3] & 0x3F);
+    t->month = BCD_to_Dec(raw[4] & 0x1F);
+    t->day  = raw[5] & 0x07;
+    t->year = BCD_to_Dec(raw[6]);
+    t->dayNumber = clockDays(t->year, t->month, t->date);
+    t->dayBase = t->dayNumber * 86400UL;
+}
+// --- Formatting kernels ---
+// The PIC16 has no divider: every / or % by 10 is a call into XC8's shift-and-subtract
+// library loop. These use BCD, shifts and fixed subtraction ladders instead
+// (bench_format compares them against the divide-based versions).
+
+// Convert BCD to Decimal (tens * 8 + tens * 2, no multiply)
+unsigned char BCD_to_Dec(unsigned char bcd) { unsigned char tens = bcd >> 4; return (unsigned char)((tens << 3) + (tens << 1) + (bcd & 0x0F)); }
+// Convert Decimal to BCD (Clamps input > 99). Four compare-and-subtract steps, 80/40/20/10,
+// leave the tens bits in the high nibble and the units in dec.
+unsigned char Dec_to_BCD(unsigned char dec) {
+    unsigned char tens = 0;
+    if (dec > 99) dec = 99;
+    if (dec >= 80) { dec -= 80; tens = 0x80; }
+    if (dec >= 40) { dec -= 40; tens |= 0x40; }
+    if (dec >= 20) { dec -= 20; tens |= 0x20; }
+    if (dec >= 10) { dec -= 10; tens |= 0x10; }
+    return tens | dec;
+}
+// Add one to a packed BCD byte (0x59 -> 0x60, 0x99 -> 0xA0)
+unsigned char bcdIncrement(unsigned char bcd) {
+    bcd++;
+    if ((bcd & 0x0F) == 0x0A) bcd += 6; // Decimal carry into the tens nibble
+    return bcd;
+}
+void putBcd(unsigned char bcd, char* out) { out[0] = (bcd >> 4) + '0'; out[1] = (bcd & 0x0F) + '0'; }
 
-    // Perform actual reset of state
-    peoplePresent = 0;
-    // Clear status bits
-    for(unsigned char i = 0; i < sizeof(presence.statusBits); i++) { presence.statusBits[i] = 0; }
-    // Clear entry time tracking
-    for(unsigned char i = 0; i < MAX_PRESENT_USERS; i++) {
-        presence.entryUserIndex[i] = 0;
-        presence.entryTimes[i] = 0;
-    }
-    delay_ms(500); // Pause after reset visual
-    resetDisplay(); // Reset LCD and state variables (including pinEntryMode)
-}
-
-
-// ------------------ DS1302 Functions (Keep as before) ------------------
-void DS1302_Init() {
-    DS1302_RST = 0; DS1302_CLK = 0;
-    TRISA &= ~((1 << 0) | (1 << 2)); // Ensure RST, CLK are output
-    TRISA &= ~(1 << 1); // Ensure IO is initially output
-}
-void DS1302_WriteByte(unsigned char data) {
-     TRISA &= ~(1 << 1); // IO as output
-    for (char i = 0; i < 8; i++) {
-        DS1302_IO = (data >> i) & 1;
-        delay_us(1); DS1302_CLK = 1; delay_us(1); DS1302_CLK = 0; delay_us(1);
-    }
-}
-unsigned char DS1302_ReadByte() {
-    unsigned char value = 0;
-    TRISA |= (1 << 1); delay_us(1); // IO as input
-    for (char i = 0; i < 8; i++) {
-        if (DS1302_IO) value |= (1 << i);
-        DS1302_CLK = 1; delay_us(1); DS1302_CLK = 0; delay_us(1);
-    }
-    TRISA &= ~(1 << 1); DS1302_IO = 0; // IO back to output low
-    return value;
-}
-void DS1302_Write(unsigned char cmd, unsigned char data) {
-    DS1302_RST = 1; delay_us(4);
-    DS1302_WriteByte(cmd); DS1302_WriteByte(data);
-    DS1302_RST = 0; delay_us(4);
-}
-unsigned char DS1302_Read(unsigned char cmd) {
-    unsigned char data;
-    DS1302_RST = 1; delay_us(4);
-    DS1302_WriteByte(cmd | 0x01); // Read command
-    data = DS1302_ReadByte();
-    DS1302_RST = 0; delay_us(4);
-    return data;
-}
-// Convert BCD to Decimal
-unsigned char BCD_to_Dec(unsigned char bcd) { return ((bcd >> 4) * 10) + (bcd & 0x0F); }
-// Convert Decimal to BCD (Clamps input > 99)
-unsigned char Dec_to_BCD(unsigned char dec) { if (dec > 99) dec = 99; return (unsigned char)(((dec / 10) << 4) | (dec % 10)); }
-
-// Get time string HH:MM:SS (8 chars + null)
-void getTimeString(char* timeStr) {
-    unsigned char sec = BCD_to_Dec(DS1302_Read(0x81) & 0x7F); // Mask CH bit
-    unsigned char min = BCD_to_Dec(DS1302_Read(0x83));
-    unsigned char hr  = BCD_to_Dec(DS1302_Read(0x85) & 0x3F); // Assuming 24hr mode
-    timeStr[0] = (hr / 10) + '0'; timeStr[1] = (hr % 10) + '0'; timeStr[2] = ':';
-    timeStr[3] = (min / 10) + '0'; timeStr[4] = (min % 10) + '0'; timeStr[5] = ':';
-    timeStr[6] = (sec / 10) + '0'; timeStr[7] = (sec % 10) + '0'; timeStr[8] = '\0';
-}
-// Get current time in seconds since midnight
-unsigned int getCurrentTimeInSeconds() {
-    unsigned char sec = BCD_to_Dec(DS1302_Read(0x81) & 0x7F);
-    unsigned char min = BCD_to_Dec(DS1302_Read(0x83));
-    unsigned char hr  = BCD_to_Dec(DS1302_Read(0x85) & 0x3F);
-    return (unsigned int)hr * 3600u + (unsigned int)min * 60u + (unsigned int)sec;
-}
-// Format seconds to HH:MM:SS string (8 chars + null)
-void formatTimeFromSeconds(unsigned int totalSeconds, char* timeStr) {
-    totalSeconds %= 86400u; // Ensure wrap around 24 hours for display
-    unsigned int hours = totalSeconds / 3600u;
-    unsigned int minutes = (totalSeconds % 3600u) / 60u;
-    unsigned int seconds = totalSeconds % 60u;
-    timeStr[0] = (hours / 10) + '0'; timeStr[1] = (hours % 10) + '0'; timeStr[2] = ':';
-    timeStr[3] = (minutes / 10) + '0'; timeStr[4] = (minutes % 10) + '0'; timeStr[5] = ':';
-    timeStr[6] = (seconds / 10) + '0'; timeStr[7] = (seconds % 10) + '0'; timeStr[8] = '\0';
-}
-
-// Find user name by roll number (using static buffer for return)
-// Returns pointer to static buffer with name, or "Unknown User"
-char* findUserName(char* rollNo) {
-    static char nameBuffer[17]; // Static buffer to return name from const memory
-    for(int i = 0; i < MAX_USERS; i++) {
-        int match = 1;
-        for(int j = 0; j < 4; j++) {
-             // Check input against const user data
-            if(users[i].rollNo[j] != rollNo[j]) {
-                match = 0;
-                break;
-            }
-        }
-        // Ensure the stored roll number is also exactly 4 characters long before null terminator
-        if(match && users[i].rollNo[4] == '\0') {
-            // Found: Copy name from const memory to static buffer
-            for(int k = 0; k < 16; k++) {
-                nameBuffer[k] = users[i].name[k];
-                if(nameBuffer[k] == '\0') break; // Stop copying at null terminator
+// Format a snapshot as HH:MM:SS (8 chars + null), straight from the BCD fields
+void formatClock(const ClockSnapshot* t, char* timeStr) {
+    putBcd(t->hour, timeStr); timeStr[2] = ':';
+    putBcd(t->min, timeStr + 3); timeStr[5] = ':';
+    putBcd(t->sec, timeStr + 6); timeStr[8] = '\0';
+}
+// Copy the software clock (CCP1 interrupt masked so the fields stay consistent)
+void clockRead(ClockSnapshot* t) {
+    HAL_ClockIrq(0);
+    *t = clockNow;
+    HAL_ClockIrq(1);
+}
+// Reload the software clock from the DS1302 and record how far it had drifted
+void clockResync() {
+    ClockSnapshot rtc;
+    DS1302_ReadClock(&rtc);
+
+    HAL_ClockIrq(0);
+    long drift = (long)(clockTimestamp(&rtc) - clockTimestamp((const ClockSnapshot*)&clockNow));
+    clockNow = rtc;
+    clockTenths = 0;
+    HAL_ClockRestart(); // Restart the current second
+    clockSinceSync = 0;
+    clockResyncDue = 0;
+    if (AUTO_CHECKOUT) checkoutDue = 1; // The clock may have jumped past (or slept through) the checkout
+    HAL_ClockIrq(1);
+
+    if (!clockSynced) { clockSynced = 1; return; } // Boot load, nothing to compare with
+    clockDrift.last = (int)drift;
+    unsigned int absDrift = (unsigned int)((drift < 0) ? -drift : drift);
+    if (absDrift > clockDrift.maxAbs) clockDrift.maxAbs = absDrift;
+    clockDrift.resyncs++;
+}
+// Days before the first of each month in a common year
+const unsigned int monthStartDays[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+// Days from 2000-01-01 to a date. Every fourth year from 2000 is a leap year, which is
+// exact for the DS1302's 2000-2099.
+unsigned int clockDays(unsigned char year, unsigned char month, unsigned char date) {
+    if (month < 1 || month > 12) month = 1; // Unset or corrupt RTC: keep the table index in range
+    unsigned int days = year * 365u + ((year + 3u) >> 2) // Leap days in the years before this one
+                      + monthStartDays[month - 1] + date - 1;
+    if ((year & 3) == 0 && month > 2) days++;
+    return days;
+}
+// Day number of a time no later than the snapshot, stepping back from its cached day.
+// Stays are short (the end-of-day checkout ends them), so this is a step or two where
+// a 32-bit divide by 86400 would be a long library loop.
+unsigned int clockDayOf(const ClockSnapshot* now, Timestamp time) {
+    unsigned int day = now->dayNumber;
+    for (Timestamp base = now->dayBase; time < base && day; base -= 86400UL) day--;
+    return day;
+}
+// Snapshot as a timestamp: the cached day base plus the time of day
+Timestamp clockTimestamp(const ClockSnapshot* t) {
+    return t->dayBase + BCD_to_Dec(t->hour) * 3600UL + BCD_to_Dec(t->min) * 60u + BCD_to_Dec(t->sec);
+}
+// Steps of the decimal ladder above the tens: 4, 2, 1 x 10000, then 8, 4, 2, 1 x 1000 and x 100
+const unsigned int decimalLadder[11] = { 40000, 20000, 10000, 8000, 4000, 2000, 1000, 800, 400, 200, 100 };
+
+// Write value as decimal digits, zero-padded to at least 'width' (no terminator). Each
+// digit takes at most four compare-and-subtract steps; values under 100 go straight to
+// Dec_to_BCD. Serves counts (width 1), HH/MM/SS fields (2) and roll numbers (4).
+// Returns the number of digits.
+unsigned char formatDigits(unsigned int value, unsigned char width, char* out) {
+    unsigned char len = 0;
+    if (value >= 100 || width > 2) {
+        unsigned char digit = 0, weight = 4, place = 5; // place: digits left, this one included
+        for (unsigned char i = 0; i < sizeof(decimalLadder) / sizeof(decimalLadder[0]); i++) {
+            if (value >= decimalLadder[i]) { value -= decimalLadder[i]; digit |= weight; }
+            weight >>= 1;
+            if (!weight) { // Last step of this decade
+                if (digit || len || place <= width) out[len++] = digit + '0';
+                digit = 0; weight = 8; place--;
             }
-            nameBuffer[16] = '\0'; // Ensure null termination
-            return nameBuffer;
         }
     }
-    // Not found: Copy "Unknown User" to the static buffer
-    const char* unknown = "Unknown User";
-    for(int k=0; k<16; k++){ // Copy up to 16 chars or null terminator
-        nameBuffer[k]=unknown[k];
-        if(!unknown[k]) break;
+    unsigned char bcd = Dec_to_BCD((unsigned char)value);
+    if (len || bcd >= 0x10 || width >= 2) out[len++] = (bcd >> 4) + '0';
+    out[len++] = (bcd & 0x0F) + '0';
+    return len;
+}
+// Quotient of *rest / unit when it is below 2^bits, by shift-and-subtract with the
+// divisor's multiples; *rest is left holding the remainder.
+unsigned int ladderDivide(unsigned long* rest, unsigned long unit, unsigned char bits) {
+    unsigned long step = unit << (bits - 1);
+    unsigned int quotient = 0;
+    while (bits--) {
+        quotient <<= 1;
+        if (*rest >= step) { *rest -= step; quotient |= 1; }
+        step >>= 1;
     }
-    nameBuffer[16] = '\0'; // Ensure null termination
-    return nameBuffer;
+    return quotient;
+}
+// Format a duration: HH:MM:SS under a day, then "<days>d HH:MM" (night shifts, forgotten
+// exits), capped at 999d 23:59 so it always fits next to its label. Returns the length.
+unsigned char formatDuration(unsigned long secs, char* out) {
+    unsigned int days = 0;
+    unsigned char len = 0;
+    if (secs >= 1000 * 86400UL) { days = 999; secs = 86399UL; }
+    else if (secs >= 86400UL) days = ladderDivide(&secs, 86400UL, 10); // Under 1000 days
+    unsigned char hours = (unsigned char)ladderDivide(&secs, 3600UL, 5); // 0-23
+    unsigned char minutes = (unsigned char)ladderDivide(&secs, 60UL, 6); // 0-59, secs keeps the seconds
+    if (days) {
+        len = formatDigits(days, 1, out);
+        out[len++] = 'd';
+        out[len++] = ' ';
+    }
+    len += formatDigits(hours, 2, out + len); out[len++] = ':';
+    len += formatDigits(minutes, 2, out + len);
+    if (!days) { out[len++] = ':'; len += formatDigits((unsigned char)secs, 2, out + len); }
+    out[len] = '\0';
+    return len;
 }
 
-// Get user index by roll number
-int getUserIndex(char* rollNo) {
-    for(int i = 0; i < MAX_USERS; i++) {
-        int match = 1;
-        for(int j = 0; j < 4; j++) {
-            if(users[i].rollNo[j] != rollNo[j]) {
-                match = 0;
-                break;
-            }
-        }
-         if(match && users[i].rollNo[4] == '\0') {
-             return i; // Match found, return index
-         }
+// Convert the 4 entered digits to a numeric roll number
+unsigned int parseID(const char* digits) {
+    unsigned int id = 0;
+    for(unsigned char i = 0; i < 4; i++) { id = id * 10 + (unsigned int)(digits[i] - '0'); }
+    return id;
+}
+
+// Binary search a sorted ID table. Returns the position of id, or -1
+int searchIds(const unsigned int* ids, unsigned int count, unsigned int id) {
+    unsigned int lo = 0, hi = count; // Search window [lo, hi)
+    while (lo < hi) {
+        unsigned int mid = lo + ((hi - lo) >> 1);
+        unsigned int key = ids[mid];
+        if (key == id) return (int)mid;
+        if (key < id) lo = mid + 1; else hi = mid;
     }
     return -1; // Not found
 }
 
+#if !USER_DIRECTORY_EXTERNAL
+// Nothing to load: the table is in program memory
+void dirInit() { }
+
+// Look up a user by numeric roll number in a single pass.
+// Returns 1 if known and points name at the user's name in the table (no copy).
+unsigned char lookupUser(unsigned int id, const char** name) {
+    dirLookups++;
+    int found = searchIds(userIds, USER_COUNT, id); // At most USER_LOOKUP_PROBES probes
+    if (found < 0) return 0;
+    unsigned int index = (unsigned int)found;
+    const char* pool = &userNames[userNameBlockAt[index / USER_NAME_BLOCK]];
+    for (unsigned char skip = index % USER_NAME_BLOCK; skip; skip--) { while (*pool++) ; } // Earlier names of the block
+    *name = pool;
+    return 1;
+}
+// Position of a user in the table, or -1 if unknown
+int userIndex(unsigned int id) { return searchIds(userIds, USER_COUNT, id); }
+#else
+// ------------------ External Directory Functions ------------------
+// Every probe of the image is one I2C random read (about 140 us for an ID at
+// 400 kHz), so a lookup costs a fence search, a page search, the name address
+// and the name read. Users found recently are kept in dirCache and answered without the bus.
+unsigned int dirReadWord(unsigned int addr) {
+    unsigned char b[2];
+    HAL_ExtEeRead(addr, b, 2);
+    return b[0] | ((unsigned int)b[1] << 8);
+}
+// Load the image header. A missing or unknown image leaves dirCount at 0, so every ID reads as invalid.
+void dirInit() {
+    unsigned char hdr[DIR_HEADER_SIZE];
+    HAL_ExtEeRead(0, hdr, DIR_HEADER_SIZE);
+    for (unsigned char i = 0; i < DIR_CACHE_SIZE; i++) { dirCache[i].id = 0; dirCacheOrder[i] = i; }
+    dirCount = 0;
+    if (hdr[DIR_HDR_MAGIC] != 'U' || hdr[DIR_HDR_MAGIC + 1] != 'D' || hdr[DIR_HDR_VERSION] != DIR_VERSION) return;
+    dirPages = hdr[DIR_HDR_PAGES] | ((unsigned int)hdr[DIR_HDR_PAGES + 1] << 8);
+    dirIndexAddr = hdr[DIR_HDR_INDEX] | ((unsigned int)hdr[DIR_HDR_INDEX + 1] << 8);
+    dirCount = hdr[DIR_HDR_COUNT] | ((unsigned int)hdr[DIR_HDR_COUNT + 1] << 8);
+}
+// Address of id's index entry in the image, or 0 if id is not in it
+unsigned int dirFind(unsigned int id) {
+    if (dirCount == 0 || id < dirReadWord(DIR_FENCE_ADDR)) return 0;
+    // Last index page whose first ID is <= id: answer in [lo, hi)
+    unsigned int lo = 0, hi = dirPages;
+    while (hi - lo > 1) {
+        unsigned int mid = lo + ((hi - lo) >> 1);
+        if (dirReadWord(DIR_FENCE_ADDR + mid * 2) <= id) lo = mid; else hi = mid;
+    }
+    unsigned int pageAddr = dirIndexAddr + lo * DIR_PAGE_SIZE;
+    hi = dirCount - lo * DIR_ENTRIES_PER_PAGE;
+    if (hi > DIR_ENTRIES_PER_PAGE) hi = DIR_ENTRIES_PER_PAGE;
+    lo = 0;
+    while (lo < hi) { // Same search as searchIds(), one bus read per probe
+        unsigned int mid = lo + ((hi - lo) >> 1);
+        unsigned int entry = pageAddr + mid * DIR_ENTRY_SIZE;
+        unsigned int key = dirReadWord(entry);
+        if (key == id) return entry;
+        if (key < id) lo = mid + 1; else hi = mid;
+    }
+    return 0;
+}
+// Look up a user by numeric roll number, cache first.
+// Returns 1 if known and points name at the first NAME_SHOWN characters of the name
+// in the cache, which stays valid until the next lookup.
+unsigned char lookupUser(unsigned int id, const char** name) {
+    dirLookups++;
+    unsigned char pos = 0;
+    while (pos < DIR_CACHE_SIZE && dirCache[dirCacheOrder[pos]].id != id) pos++;
+    if (pos < DIR_CACHE_SIZE && id != 0) {
+        dirHits++;
+    } else { // Miss: search the image and reuse the least recently used entry
+        unsigned int entry = dirFind(id);
+        if (entry == 0) return 0; // Unknown IDs are not cached
+        pos = DIR_CACHE_SIZE - 1;
+        DirCacheEntry* e = &dirCache[dirCacheOrder[pos]];
+        e->id = id;
+        HAL_ExtEeRead(dirReadWord(entry + 2), (unsigned char*)e->name, NAME_SHOWN); // May run into the next name; the NUL ends it
+        e->name[NAME_SHOWN] = '\0';
+    }
+    unsigned char entry = dirCacheOrder[pos];
+    for (; pos; pos--) dirCacheOrder[pos] = dirCacheOrder[pos - 1]; // Move to the front
+    dirCacheOrder[0] = entry;
+    *name = dirCache[entry].name;
+    return 1;
+}
+// Position of a user in the image's index, or -1 if unknown (a bus search, not cached)
+int userIndex(unsigned int id) {
+    unsigned int entry = dirFind(id);
+    if (entry == 0) return -1;
+    return (int)((entry - dirIndexAddr) / DIR_ENTRY_SIZE); // Index pages are full pages of entries
+}
+#endif
+
 // Clear the second line of the LCD by writing 16 spaces
 void clearSecondLine() { Send2Lcd(0xC0, "                "); }
 // Clear the first line of the LCD by writing 16 spaces
 void clearLine1() { Send2Lcd(0x80, "                "); }
 
-// ------------------ LCD Functions (Keep as before) ------------------
+// ------------------ LCD Functions ------------------
+// Screens never talk to the HD44780 directly: they write into lcdShadow and
+// LCD_Flush() sends only the cells that changed since the last flush.
+char lcdShadow[2][16];        // What the display should show
+unsigned char lcdDirty[4];    // One bit per cell (row * 16 + col) not yet sent
+unsigned char lcdCursor = 0xFF; // Cell the LCD address counter points at, 0xFF = unknown
+
+// Poll the busy flag (DB7) instead of waiting out worst-case execution times.
+// Gives up after 255 polls so a missing RW connection cannot hang the terminal.
+void LCD_WaitBusy() {
+    unsigned char tries = 255;
+    while (HAL_LcdBusy() && --tries);
+}
 void LCD_Cmd(unsigned char cmd) {
-    LCD_RS = 0; LCD_RW = 0; LCD_PORT = cmd;
-    LCD_E = 1; delay_us(1); LCD_E = 0;
-    // Use longer delay only for specific commands like clear/home
-    if (cmd == 0x01 || cmd == 0x02) delay_ms(2); else delay_us(50);
+    LCD_WaitBusy();
+    HAL_LcdWrite(0, cmd);
 }
 void LCD_Data(unsigned char data) {
-    LCD_RS = 1; LCD_RW = 0; LCD_PORT = data;
-    LCD_E = 1; delay_us(1); LCD_E = 0;
-    delay_us(50); // Delay for data write processing
+    LCD_WaitBusy();
+    HAL_LcdWrite(1, data);
 }
 void LCD_Init() {
-    LCD_E = 0; LCD_RS = 0; LCD_RW = 0; delay_ms(20); // Power on delay
-    LCD_Cmd(0x38); delay_ms(5);   // Function Set: 8-bit, 2 Line, 5x7 dots
-    LCD_Cmd(0x38); delay_us(150); // Repeat Function Set
-    LCD_Cmd(0x38); delay_us(150); // Repeat Function Set
-    LCD_Cmd(0x0C); delay_us(150); // Display ON, Cursor OFF, Blink OFF
-    LCD_Cmd(0x01); delay_ms(2);   // Clear Display Screen
-    LCD_Cmd(0x06); delay_us(150); // Entry Mode Set: Increment cursor, No shift
-}
-// Set cursor position (row 0 or 1, col 0-15)
-void LCD_SetCursor(char row, char col) {
-    if (col >= 16) col = 15; // Limit column
-    if (col < 0) col = 0;
-    if (row < 0) row = 0;
-    if (row > 1) row = 1;
-    LCD_Cmd(((row == 0) ? 0x80 : 0xC0) + col);
-}
-// Send string to LCD starting at specified address (0x80 or 0xC0 based)
+    // The busy flag cannot be read until the function set is accepted, so the
+    // start-up sequence keeps its fixed delays.
+    delay_ms(20); // Power on delay
+    HAL_LcdWrite(0, 0x38); delay_ms(5);   // Function Set: 8-bit, 2 Line, 5x7 dots
+    HAL_LcdWrite(0, 0x38); delay_us(150); // Repeat Function Set
+    HAL_LcdWrite(0, 0x38); delay_us(150); // Repeat Function Set
+    LCD_Cmd(0x0C); // Display ON, Cursor OFF, Blink OFF
+    LCD_Cmd(0x01); // Clear Display Screen
+    LCD_Cmd(0x06); // Entry Mode Set: Increment cursor, No shift
+
+    // Shadow matches the freshly cleared display
+    for (unsigned char i = 0; i < 16; i++) { lcdShadow[0][i] = ' '; lcdShadow[1][i] = ' '; }
+    for (unsigned char i = 0; i < sizeof(lcdDirty); i++) { lcdDirty[i] = 0; }
+    lcdCursor = 0xFF;
+}
+// Write one character into the shadow buffer (row 0 or 1, col 0-15)
+void LCD_Put(unsigned char row, unsigned char col, char c) {
+    if (row > 1 || col >= 16) return; // Off screen
+    if (lcdShadow[row][col] == c) return; // Unchanged cells cost nothing
+    lcdShadow[row][col] = c;
+    unsigned char cell = (row << 4) | col;
+    lcdDirty[cell >> 3] |= (1 << (cell & 7));
+}
+// Write a string into the shadow buffer, clipped at the end of the line.
+// Returns the column after the last character.
+unsigned char LCD_Print(unsigned char row, unsigned char col, const char *str) {
+    while (*str && col < 16) { LCD_Put(row, col++, *str++); }
+    return col;
+}
+// Send the dirty cells to the display. Runs of adjacent cells share one
+// cursor command since the HD44780 auto-increments its address counter.
+void LCD_Flush() {
+    for (unsigned char byteIndex = 0; byteIndex < sizeof(lcdDirty); byteIndex++) {
+        unsigned char bits = lcdDirty[byteIndex];
+        if (bits == 0) continue; // Skip 8 clean cells at once
+        lcdDirty[byteIndex] = 0;
+        for (unsigned char bit = 0; bits; bit++, bits >>= 1) {
+            if (!(bits & 1)) continue;
+            unsigned char cell = (byteIndex << 3) | bit;
+            if (lcdCursor != cell) { LCD_Cmd(((cell & 0x10) ? 0xC0 : 0x80) | (cell & 0x0F)); }
+            LCD_Data(lcdShadow[cell >> 4][cell & 0x0F]);
+            // Address counter runs 0x0F -> 0x10, not onto line 2
+            lcdCursor = ((cell & 0x0F) == 0x0F) ? 0xFF : cell + 1;
+        }
+    }
+}
+// Write string into the shadow buffer at an LCD address (0x80 or 0xC0 based)
 void Send2Lcd(const char Adr, const char *Lcd) {
-    LCD_Cmd(Adr); // Set cursor position
-    while(*Lcd) { // While character is not null terminator
-        LCD_Data(*Lcd++); // Send character and increment pointer
+    LCD_Print((Adr & 0x40) ? 1 : 0, Adr & 0x0F, Lcd);
+}
+
+// ------------------ Data EEPROM Functions ------------------
+// Byte writes take ~4 ms each, so they are queued and fed to the EEPROM one at
+// a time from the EEIF interrupt; the caller never waits for the cells.
+unsigned char eeQueueAddr[EE_QUEUE_SIZE];
+unsigned char eeQueueData[EE_QUEUE_SIZE];
+volatile unsigned char eeHead = 0;    // Main loop adds at head
+volatile unsigned char eeTail = 0;    // ISR takes from tail
+volatile unsigned char eeWriting = 0; // A byte write is in progress
+
+unsigned char eeRead(unsigned char addr) { return HAL_EeRead(addr); }
+unsigned char eeQueueFree() {
+    return (EE_QUEUE_SIZE - 1) - ((eeHead - eeTail) & (EE_QUEUE_SIZE - 1));
+}
+// Queue one byte write (caller checks eeQueueFree() first)
+void eeQueueWrite(unsigned char addr, unsigned char data) {
+    eeQueueAddr[eeHead] = addr;
+    eeQueueData[eeHead] = data;
+    eeHead = (eeHead + 1) & (EE_QUEUE_SIZE - 1);
+}
+// Start the queue draining if the EEPROM is idle
+void eeKick() {
+    unsigned char gie = HAL_IrqDisable();
+    if (!eeWriting) eeWriteNext();
+    HAL_IrqRestore(gie);
+}
+// Start the next queued byte write. Runs with interrupts off (from the ISR or eeKick).
+void eeWriteNext() {
+    if (eeTail == eeHead) { eeWriting = 0; return; }
+    eeWriting = 1;
+    HAL_EeWrite(eeQueueAddr[eeTail], eeQueueData[eeTail]); // HAL_OnEeDone() follows
+    eeTail = (eeTail + 1) & (EE_QUEUE_SIZE - 1);
+}
+
+// Presence snapshot: every presence slot has two 8-byte copies in EEPROM,
+//   [0] sequence  [1..2] roll number (0 = empty)  [3..6] entry time  [7] checksum
+// (multi-byte fields LSB first)
+// A change rewrites only that slot, into the copy holding the older sequence
+// number, so a power cut mid-write leaves the previous copy intact. At boot the
+// newest copy that passes its checksum wins.
+// The checksum also folds in the epoch key kept (inverted, so an erased cell is key 0)
+// at SNAP_EPOCH_ADDR. Emptying the whole table is one byte write: a new key makes
+// every record written under the old one fail its checksum.
+HAL_BANK(PRESENCE_TIMES_BANK) unsigned char snapSeq[MAX_PRESENT_USERS]; // Sequence number of each slot's newest copy
+unsigned char snapRepairFrom = MAX_PRESENT_USERS; // First slot whose EEPROM copy no longer matches RAM
+unsigned char snapKey = 0;        // Current epoch key (read at boot)
+
+unsigned char snapChecksum(const unsigned char* rec) {
+    unsigned char sum = 0;
+    for (unsigned char i = 0; i < SNAP_RECORD_SIZE - 1; i++) sum += rec[i];
+    return sum ^ 0xA5 ^ snapKey; // Neither all-0x00 nor all-0xFF cells read as valid (see snapshotClear)
+}
+// Queue the current contents of one presence slot. Unlike log records these are
+// never dropped; if the queue is full this waits for the ISR to drain it.
+void snapshotWriteSlot(unsigned char slot) {
+    unsigned char rec[SNAP_RECORD_SIZE];
+    Timestamp time = presenceTimes[slot];
+    rec[0] = ++snapSeq[slot];
+    rec[1] = (unsigned char)presence.entryIds[slot];
+    rec[2] = (unsigned char)(presence.entryIds[slot] >> 8);
+    rec[3] = (unsigned char)time;
+    rec[4] = (unsigned char)(time >> 8);
+    rec[5] = (unsigned char)(time >> 16);
+    rec[6] = (unsigned char)(time >> 24);
+    rec[7] = snapChecksum(rec);
+
+    unsigned char addr = SNAP_BASE + (slot * 2 + (rec[0] & 1)) * SNAP_RECORD_SIZE; // Copies alternate
+    while (eeQueueFree() < SNAP_RECORD_SIZE) delay_us(100); // Only if a burst of events (or a reset) is still being written
+    for (unsigned char i = 0; i < SNAP_RECORD_SIZE; i++) eeQueueWrite(addr + i, rec[i]);
+    eeKick();
+}
+// Rebuild presence from the snapshot after a reset (runs before interrupts are on).
+// Restored occupants are packed into slots [0, peoplePresent); if that moves anything
+// (a power cut in the middle of an exit's slot move), the EEPROM copies from the
+// first difference on are rewritten by snapshotRepair() once interrupts run.
+void snapshotRestore() {
+    snapKey = eeRead(SNAP_EPOCH_ADDR) ^ 0xFF;
+    for (unsigned char slot = 0; slot < MAX_PRESENT_USERS; slot++) {
+        unsigned char copy[2][SNAP_RECORD_SIZE];
+        unsigned char valid[2];
+        for (unsigned char c = 0; c < 2; c++) {
+            unsigned char addr = SNAP_BASE + (slot * 2 + c) * SNAP_RECORD_SIZE;
+            for (unsigned char i = 0; i < SNAP_RECORD_SIZE; i++) copy[c][i] = eeRead(addr + i);
+            valid[c] = (copy[c][SNAP_RECORD_SIZE - 1] == snapChecksum(copy[c]));
+        }
+        if (!valid[0] && !valid[1]) { snapSeq[slot] = 0; continue; } // Never written: slot empty
+
+        unsigned char use = valid[0] ? 0 : 1;
+        if (valid[0] && valid[1] && (signed char)(copy[1][0] - copy[0][0]) > 0) use = 1;
+        const unsigned char* rec = copy[use];
+        snapSeq[slot] = rec[0];
+
+        unsigned int id = rec[1] | ((unsigned int)rec[2] << 8);
+        if (id == 0) continue; // Empty slot
+        if (isUserPresent(id)) { // Duplicate
+            if (slot < snapRepairFrom) snapRepairFrom = slot;
+            continue;
+        }
+        unsigned char dest = peoplePresent++;
+        if (dest != slot && dest < snapRepairFrom) snapRepairFrom = dest;
+        presence.entryIds[dest] = id;
+        presenceTimes[dest] = rec[3] | ((unsigned int)rec[4] << 8) | ((Timestamp)rec[5] << 16) | ((Timestamp)rec[6] << 24);
+        presenceLink(dest);
+    }
+}
+// Bring the EEPROM snapshot back in line with the packed RAM slots after a restore
+void snapshotRepair() {
+    for (unsigned char slot = snapRepairFrom; slot < MAX_PRESENT_USERS; slot++) snapshotWriteSlot(slot);
+    snapRepairFrom = MAX_PRESENT_USERS;
+}
+// Mark every snapshot slot empty by moving to the next epoch key (call with the
+// presence slots already cleared). Keys 0xA5 and 0xA3 are skipped: under them an
+// all-0x00 or all-0xFF record would pass its checksum. After 254 keys the sequence
+// comes back round, so at key 0 both copies of every slot are rewritten (empty) once,
+// and no record from an earlier round can match a later key again.
+void snapshotClear() {
+    do { snapKey++; } while (snapKey == 0xA5 || snapKey == 0xA3);
+    while (eeQueueFree() < 1) delay_us(100);
+    eeQueueWrite(SNAP_EPOCH_ADDR, snapKey ^ 0xFF);
+    eeKick();
+    if (snapKey) return;
+    for (unsigned char slot = 0; slot < MAX_PRESENT_USERS; slot++) {
+        snapshotWriteSlot(slot);
+        snapshotWriteSlot(slot);
     }
 }
 
-// ------------------ Delay Functions (Optimized slightly for 20MHz) ------------------
+// ------------------ Event Log Functions ------------------
+// A ring of fixed-size records on the totals 24LC256, written in turn so every page
+// sees the same number of write cycles. The head is not stored anywhere - it is found
+// at boot from the record sequence numbers. Record layout:
+//   [0..1] roll number  [2] flags: EV_ENTRY | 7-bit checksum  [3..6] time
+//   [7..8] sequence number (0xFFFF = never written), all LSB first
+// The checksum covers every other byte, so a record torn by a power cut during its
+// page write reads back as invalid instead of as garbage. Sequence numbers skip
+// 0xFFFF, so consecutive records always differ by one step of evlogNextSeq.
+// A position in the ring is an EEPROM address plus the slot's place in its page,
+// stepped a slot at a time, so finding a record needs no divide by EVLOG_PER_PAGE.
+unsigned int evlogHeadAddr = EVLOG_BASE; // Slot the next record goes to
+unsigned char evlogHeadIndex = 0;     // Its place in its page
+unsigned int evlogNextSeq = 0;        // Sequence number of the next record
+unsigned char evlogPendingRec[EVLOG_RECORD_SIZE]; // Newest record, until the chip can take it
+unsigned int evlogPendingAddr;        // Where it goes
+unsigned char evlogPending = 0;       // 1 while it waits
+unsigned char totalsChipMissing = 0;  // The totals 24LC256 did not answer at boot: no log or totals I/O until a reset
+
+// Step a ring position to the next slot, from the last slot of a page to the start of
+// the next page, and from the last page back to the first
+void evlogStep(unsigned int* addr, unsigned char* index) {
+    if (++*index < EVLOG_PER_PAGE) { *addr += EVLOG_RECORD_SIZE; return; }
+    *index = 0;
+    unsigned int page = (*addr & ~63u) + 64;
+    *addr = ((unsigned int)(page - EVLOG_BASE) == EVLOG_PAGES * 64u) ? EVLOG_BASE : page;
+}
+// Move a ring position 'back' slots towards the oldest record, a page at a time
+// (once per download request, at most EVLOG_PAGES steps)
+void evlogStepBack(unsigned int* addr, unsigned char* index, unsigned int back) {
+    unsigned int page = *addr & ~63u;
+    unsigned int at = *index;
+    while (back > at) { // Into the page before, wrapping from the first to the last
+        at += EVLOG_PER_PAGE;
+        page = (page == EVLOG_BASE) ? EVLOG_BASE + (EVLOG_PAGES - 1) * 64u : page - 64;
+    }
+    *index = (unsigned char)(at - back);
+    *addr = page + *index * EVLOG_RECORD_SIZE;
+}
+unsigned char evlogChecksum(const unsigned char* rec) {
+    unsigned char sum = rec[0] + rec[1];
+    for (unsigned char i = 3; i < EVLOG_RECORD_SIZE; i++) sum += rec[i];
+    return sum & 0x7F;
+}
+// Read the slot at addr; returns 1 if it holds a valid record
+unsigned char evlogRead(unsigned int addr, unsigned char* rec) {
+    HAL_ExtEeRead(addr, rec, EVLOG_RECORD_SIZE);
+    return (rec[7] & rec[8]) != 0xFF && (rec[2] & 0x7F) == evlogChecksum(rec);
+}
+// Scan the ring for the newest valid record; the next write goes after it. One read
+// per slot, page by page, so no division. Each read is 13 bytes and a restart on the
+// bus (~288 us), so the 896 slots take about 0.26 s, once at power-up. The first read
+// is also the probe for the chip: if it never answers, the log and the totals are
+// skipped from then on instead of every access timing out.
+void evlogInit() {
+    unsigned char found = 0;
+    unsigned int newest = 0, addr = EVLOG_BASE;
+    for (unsigned char page = 0; page < EVLOG_PAGES; page++, addr += 64 - EVLOG_PER_PAGE * EVLOG_RECORD_SIZE) {
+        for (unsigned char i = 0; i < EVLOG_PER_PAGE; i++, addr += EVLOG_RECORD_SIZE) {
+            unsigned char rec[EVLOG_RECORD_SIZE];
+            if (!HAL_ExtEeRead(addr, rec, EVLOG_RECORD_SIZE)) { totalsChipMissing = 1; return; }
+            unsigned int seq = rec[7] | ((unsigned int)rec[8] << 8);
+            if (seq == 0xFFFF || (rec[2] & 0x7F) != evlogChecksum(rec)) continue;
+            if (!found || (short)(seq - newest) > 0) { // Wrap-safe "newer than" (16-bit sequence)
+                found = 1;
+                newest = seq;
+                evlogHeadAddr = addr;
+                evlogHeadIndex = i;
+            }
+        }
+    }
+    if (found) evlogStep(&evlogHeadAddr, &evlogHeadIndex); // The slot after the newest
+    evlogNextSeq = found ? newest + 1 : 0;
+    if (evlogNextSeq == 0xFFFF) evlogNextSeq = 0;
+}
+// Append one event. The record waits in RAM and evlogPoll() writes it once the chip
+// is free, so an exit does not sit out the totals write cycle first. Only a second
+// event within the same write cycle waits, for the first one to go out.
+void evlogAppend(unsigned int roll, unsigned char flags, Timestamp time) {
+    unsigned char* rec = evlogPendingRec;
+    if (evlogPending) evlogFlush();
+    rec[0] = (unsigned char)roll;
+    rec[1] = (unsigned char)(roll >> 8);
+    rec[3] = (unsigned char)time;
+    rec[4] = (unsigned char)(time >> 8);
+    rec[5] = (unsigned char)(time >> 16);
+    rec[6] = (unsigned char)(time >> 24);
+    rec[7] = (unsigned char)evlogNextSeq;
+    rec[8] = (unsigned char)(evlogNextSeq >> 8);
+    rec[2] = (flags & EV_ENTRY) | evlogChecksum(rec);
+    evlogPending = !totalsChipMissing; // Still numbered without a chip: the live stream uses the sequence
+    evlogPendingAddr = evlogHeadAddr;
+
+    evlogStep(&evlogHeadAddr, &evlogHeadIndex);
+    if (++evlogNextSeq == 0xFFFF) evlogNextSeq = 0;
+}
+// Write the waiting record: one page write, which the chip finishes on its own
+void evlogFlush() {
+    HAL_ExtEeWrite(evlogPendingAddr, evlogPendingRec, EVLOG_RECORD_SIZE);
+    evlogPending = 0;
+}
+// Main loop: write the waiting record as soon as the chip answers (one control byte to ask)
+void evlogPoll() {
+    if (evlogPending && HAL_ExtEeIdle(EVLOG_BASE)) evlogFlush();
+}
+// Records from 'seq' up to the newest, i.e. how far back from the head 'seq' sits
+// (EVLOG_SLOTS if it is older than the ring reaches)
+unsigned int evlogSpan(unsigned int seq) {
+    unsigned int span = evlogNextSeq - seq;
+    if (seq > evlogNextSeq) span--; // Ran through 0xFFFF, which no record uses
+    return span > EVLOG_SLOTS ? EVLOG_SLOTS : span;
+}
+// Oldest stored sequence number, 0xFFFF if the log is empty. Once the ring has
+// wrapped that is the record the head overwrites next, before that the first slot.
+unsigned int evlogOldest() {
+    unsigned char rec[EVLOG_RECORD_SIZE];
+    if (totalsChipMissing) return 0xFFFF;
+    if (!evlogRead(evlogHeadAddr, rec) && !evlogRead(EVLOG_BASE, rec)) return 0xFFFF;
+    return rec[7] | ((unsigned int)rec[8] << 8);
+}
 
-void delay_ms(unsigned int ms) {
-    while(ms--) {
+// Log an entry or exit and stream it to the central system under the same sequence number
+void recordEvent(unsigned int roll, unsigned char flags, Timestamp time, unsigned long duration) {
+    unsigned char frame[EVENT_PAYLOAD_SIZE];
+    unsigned int seq = evlogNextSeq;
+    evlogAppend(roll, flags, time);
+
+    frame[EVENT_TERMINAL] = TERMINAL_ID;
+    frame[EVENT_SEQ] = (unsigned char)seq;
+    frame[EVENT_SEQ + 1] = (unsigned char)(seq >> 8);
+    frame[EVENT_ROLL] = (unsigned char)roll;
+    frame[EVENT_ROLL + 1] = (unsigned char)(roll >> 8);
+    frame[EVENT_DIRECTION] = (flags & EV_ENTRY) ? 1 : 0;
+    for (unsigned char i = 0; i < 4; i++) {
+        frame[EVENT_TIME + i] = (unsigned char)(time >> (i * 8));
+        frame[EVENT_DURATION + i] = (unsigned char)(duration >> (i * 8));
+    }
+    uartSendFrame(FRAME_EVENT, frame, EVENT_PAYLOAD_SIZE);
+}
 
-        volatile unsigned int i;
-        // The exact count (1660) depends on compiler, adjust if needed
-        for(i = 0; i < 1660; i++);
-     }
+// ------------------ End-of-Day Checkout ------------------
+// Runs when the ISR reaches the checkout minute and after every clock reload, so a
+// checkout the terminal slept through (or was powered off for) still happens, at
+// its scheduled time, as soon as the clock is known again.
+void checkoutPoll() {
+    checkoutDue = 0;
+    ClockSnapshot now;
+    clockRead(&now);
+    Timestamp at = now.dayBase + AUTO_CHECKOUT_HOUR * 3600UL + AUTO_CHECKOUT_MINUTE * 60u;
+    if (clockTimestamp(&now) < at) { // Latest scheduled checkout: yesterday's
+        if (at < 86400UL) return; // 2000-01-01 (an unset RTC): there was none
+        at -= 86400UL;
+    }
+    if (at == checkoutDone) return;
+    checkoutDone = at;
+    autoCheckout(at);
+}
+// Check out everyone who came in before 'at', at 'at', in one pass over the slots.
+// Each exit is logged and added to the totals as a badge exit would be; the stream
+// gets them as FRAME_CHECKOUT batches instead of one FRAME_EVENT each. Anyone who
+// came in later stays, packed to the front of the slots.
+void autoCheckout(Timestamp at) {
+    unsigned char count = peoplePresent, kept = 0, batched = 0;
+    ClockSnapshot now;
+    clockRead(&now); // Day numbers for the totals
+    for (unsigned char slot = 0; slot < count; slot++) {
+        unsigned int id = presence.entryIds[slot];
+        Timestamp entryTime = presenceTimes[slot];
+        if (entryTime > at) {
+            presence.entryIds[kept] = id;
+            presenceTimes[kept++] = entryTime;
+            continue;
+        }
+        unsigned long duration = at - entryTime;
+        if (!batched) { // Wait for room rather than drop part of the batch
+            while (uartTxFree() < CHK_RECORDS + CHK_RECORDS_PER_FRAME * CHK_RECORD_SIZE + PROTO_OVERHEAD) delay_us(100);
+            uartFrameBegin(FRAME_CHECKOUT, CHK_RECORDS + CHK_RECORDS_PER_FRAME * CHK_RECORD_SIZE);
+            uartFramePut(TERMINAL_ID);
+            uartFramePut((unsigned char)evlogNextSeq);
+            uartFramePut((unsigned char)(evlogNextSeq >> 8));
+            for (unsigned char i = 0; i < 4; i++) uartFramePut((unsigned char)(at >> (i * 8)));
+        }
+        evlogAppend(id, 0, at);
+        totalsAdd(id, clockDayOf(&now, entryTime), duration);
+        uartFramePut((unsigned char)id);
+        uartFramePut((unsigned char)(id >> 8));
+        for (unsigned char i = 0; i < 4; i++) uartFramePut((unsigned char)(duration >> (i * 8)));
+        if (++batched == CHK_RECORDS_PER_FRAME) { uartFrameEnd(); batched = 0; }
+    }
+    if (batched) uartFrameEnd();
+    if (kept == count) return; // Nobody was checked out
+
+    peoplePresent = kept;
+    listSlot = 0;
+    listNumber = 0;
+    memset(presence.idSlot, 0, sizeof(presence.idSlot));
+    for (unsigned char slot = 0; slot < count; slot++) {
+        if (slot < kept) presenceLink(slot);
+        else { presence.entryIds[slot] = 0; presenceTimes[slot] = 0; }
+    }
+    if (!kept) snapshotClear(); // The usual case: one byte empties the snapshot
+    else for (unsigned char slot = 0; slot < count; slot++) snapshotWriteSlot(slot);
 }
 
-void delay_us(unsigned int us) {
+// ------------------ UART Event Stream ------------------
+// Frames are copied into a ring and sent a byte at a time from the transmit
+// interrupt, so nothing on the keypad path waits for the line. Frames from the
+// host are parsed byte by byte in the receive interrupt and handed to the main
+// loop one at a time.
+unsigned char uartTxFree() {
+    return (UART_TX_SIZE - 1) - ((uartTxHead - uartTxTail) & (UART_TX_SIZE - 1));
+}
+// Start a frame of up to maxLen payload bytes. Returns 0 (and counts a drop) if
+// that much might not fit. The frame goes out only after uartFrameEnd().
+unsigned char uartFrameBegin(unsigned char type, unsigned char maxLen) {
+    if (uartTxFree() < maxLen + PROTO_OVERHEAD) { uartFramesDropped++; return 0; }
+    uartTxFrame = uartTxHead;
+    uartTxPos = uartTxHead;
+    uartFramePut(PROTO_SYNC);
+    uartFramePut(type);
+    uartFramePut(0); // Length, filled in by uartFrameEnd()
+    return 1;
+}
+void uartFramePut(unsigned char data) {
+    uartTxBuf[uartTxPos] = data;
+    uartTxPos = (uartTxPos + 1) & (UART_TX_SIZE - 1);
+}
+// Fill in the length, append the CRC and publish the frame in one step
+void uartFrameEnd() {
+    unsigned char lenAt = (uartTxFrame + 2) & (UART_TX_SIZE - 1);
+    uartTxBuf[lenAt] = ((uartTxPos - uartTxFrame) & (UART_TX_SIZE - 1)) - 3;
+    unsigned int crc = PROTO_CRC_INIT;
+    for (unsigned char i = (uartTxFrame + 1) & (UART_TX_SIZE - 1); i != uartTxPos; i = (i + 1) & (UART_TX_SIZE - 1)) {
+        crc = protoCrc16(crc, uartTxBuf[i]);
+    }
+    uartFramePut((unsigned char)crc);
+    uartFramePut((unsigned char)(crc >> 8));
+    uartTxHead = uartTxPos;
+    HAL_UartTxIrq(1);
+}
+// Queue a whole frame, or drop it (and count the drop) if it does not fit
+unsigned char uartSendFrame(unsigned char type, const unsigned char* payload, unsigned char len) {
+    if (!uartFrameBegin(type, len)) return 0;
+    for (unsigned char i = 0; i < len; i++) uartFramePut(payload[i]);
+    uartFrameEnd();
+    return 1;
+}
+// Transmit buffer empty: send the next byte, or stop the interrupt when the ring is drained
+void HAL_OnUartTx() {
+    if (uartTxTail == uartTxHead) { HAL_UartTxIrq(0); return; }
+    HAL_UartTxByte(uartTxBuf[uartTxTail]);
+    uartTxTail = (uartTxTail + 1) & (UART_TX_SIZE - 1);
+}
+// One received byte: walk the frame format, resynchronising on the next sync byte after any error
+void HAL_OnUartRx(unsigned char data) {
+    switch (uartRxState) {
+        case RX_SYNC:
+            if (data == PROTO_SYNC) uartRxState = RX_TYPE;
+            return;
+        case RX_TYPE:
+            if (uartRxReady) { uartRxDropped++; uartRxState = RX_SYNC; return; } // Previous frame not handled yet
+            uartRxType = data;
+            uartRxCrc = protoCrc16(PROTO_CRC_INIT, data);
+            uartRxState = RX_LEN;
+            return;
+        case RX_LEN:
+            if (data > PROTO_MAX_RX_PAYLOAD) { uartRxDropped++; uartRxState = RX_SYNC; return; }
+            uartRxLen = data;
+            uartRxPos = 0;
+            uartRxCrc = protoCrc16(uartRxCrc, data);
+            uartRxState = data ? RX_PAYLOAD : RX_CRC_LO;
+            return;
+        case RX_PAYLOAD:
+            uartRxPayload[uartRxPos++] = data;
+            uartRxCrc = protoCrc16(uartRxCrc, data);
+            if (uartRxPos == uartRxLen) uartRxState = RX_CRC_LO;
+            return;
+        case RX_CRC_LO:
+            if (data != (unsigned char)uartRxCrc) { uartRxDropped++; uartRxState = RX_SYNC; return; }
+            uartRxState = RX_CRC_HI;
+            return;
+        case RX_CRC_HI:
+            if (data == (unsigned char)(uartRxCrc >> 8)) uartRxReady = 1;
+            else uartRxDropped++;
+            uartRxState = RX_SYNC;
+            return;
+    }
+}
 
-     while(us--) {
-        _nop(); _nop(); _nop(); // ~3 cycles
+// Act on the frame the receive interrupt handed over
+void uartCommand() {
+    unsigned int seq = uartRxPayload[0] | ((unsigned int)uartRxPayload[1] << 8);
+    if (uartRxType == FRAME_LOG_REQUEST && uartRxLen == REQ_PAYLOAD_SIZE) {
+        logActive = 1;
+        logLeft = totalsChipMissing ? 0 : evlogSpan(seq); // Start at the requested record, not at the oldest
+        logAddr = evlogHeadAddr;
+        logIndex = evlogHeadIndex;
+        evlogStepBack(&logAddr, &logIndex, logLeft);
+        logSendSeq = seq;
+        logAckSeq = seq;
+        logWindow = uartRxPayload[REQ_WINDOW] ? uartRxPayload[REQ_WINDOW] : LOG_DEFAULT_WINDOW;
+    } else if (uartRxType == FRAME_LOG_ACK && uartRxLen == ACK_PAYLOAD_SIZE) {
+        logAckSeq = seq;
+    } else if (uartRxType == FRAME_TOTALS_REQUEST && uartRxLen == TREQ_PAYLOAD_SIZE) {
+        UserTotals t;
+        unsigned int addr;
+        unsigned char reply[TOT_PAYLOAD_SIZE];
+        reply[TOT_STATUS] = totalsRead(seq, &t, &addr); // Anything but TOT_OK comes with no visits
+        reply[TOT_ROLL] = uartRxPayload[TREQ_ROLL];
+        reply[TOT_ROLL + 1] = uartRxPayload[TREQ_ROLL + 1];
+        reply[TOT_DAY] = (unsigned char)t.day;
+        reply[TOT_DAY + 1] = (unsigned char)(t.day >> 8);
+        for (unsigned char i = 0; i < 4; i++) reply[TOT_SECONDS + i] = (unsigned char)(t.seconds >> (i * 8));
+        reply[TOT_VISITS] = t.visits;
+        uartSendFrame(FRAME_TOTALS, reply, TOT_PAYLOAD_SIZE); // A dropped reply is asked for again
+    }
+    uartRxReady = 0; // Receive interrupt may take the next frame
+}
 
-     }
+// Send the next batch of a log download, if the window and the transmit ring allow.
+// Records are read straight from the event log ring, from the requested one on, so
+// they go out in sequence order without being copied anywhere first.
+void logPump() {
+    if (!logActive || evlogPending) return; // The newest record reaches the ring first
+    if ((unsigned int)((logSendSeq - logAckSeq) & 0xFFFF) >= logWindow) return; // Wait for an ACK
+    if (uartTxFree() < LOG_RECORDS_PER_FRAME * LOG_RECORD_SIZE + PROTO_OVERHEAD) return;
+
+    if (logLeft == 0) { // Up to the head
+        unsigned int oldest = evlogOldest();
+        unsigned char end[END_PAYLOAD_SIZE];
+        end[END_NEXT_SEQ] = (unsigned char)evlogNextSeq;
+        end[END_NEXT_SEQ + 1] = (unsigned char)(evlogNextSeq >> 8);
+        end[END_OLDEST_SEQ] = (unsigned char)oldest;
+        end[END_OLDEST_SEQ + 1] = (unsigned char)(oldest >> 8);
+        uartSendFrame(FRAME_LOG_END, end, END_PAYLOAD_SIZE);
+        logActive = 0;
+        return;
+    }
+
+    unsigned char count = 0;
+    uartFrameBegin(FRAME_LOG_DATA, LOG_RECORDS_PER_FRAME * LOG_RECORD_SIZE); // Room checked above
+    while (count < LOG_RECORDS_PER_FRAME && logLeft
+           && (unsigned int)((logSendSeq - logAckSeq) & 0xFFFF) < logWindow) {
+        unsigned char rec[EVLOG_RECORD_SIZE];
+        unsigned char valid = evlogRead(logAddr, rec);
+        evlogStep(&logAddr, &logIndex);
+        logLeft--;
+        unsigned int seq = rec[7] | ((unsigned int)rec[8] << 8);
+        if (!valid || (short)(seq - logSendSeq) < 0) continue; // Torn, or the host already has it
+
+        uartFramePut((unsigned char)seq);
+        uartFramePut((unsigned char)(seq >> 8));
+        uartFramePut(rec[0]); // Roll number, already LSB first
+        uartFramePut(rec[1]);
+        uartFramePut((rec[2] & EV_ENTRY) ? 1 : 0);
+        for (unsigned char i = 3; i < 7; i++) uartFramePut(rec[i]); // Time, already LSB first
+        logSendSeq = (seq == 0xFFFE) ? 0 : seq + 1; // 0xFFFF is never used
+        count++;
+    }
+    if (count) uartFrameEnd(); // An empty batch is simply never published
+}
+
+// ------------------ Idle Sleep Functions ------------------
+// Nothing in flight that needs the oscillator: no key or screen pending, EEPROM
+// writes done, transmit ring empty and no host frame or download under way
+unsigned char appIdle() {
+    return keyHead == keyTail && kpState == KP_IDLE && uiNext == UI_NONE
+        && eeHead == eeTail && !eeWriting && !evlogPending
+        && uartTxHead == uartTxTail && uartRxState == RX_SYNC && !uartRxReady && !logActive
+        && !clockResyncDue && !checkoutDue;
+}
+
+// Sleep until a key is pressed. Wake-up to a queued key takes the oscillator start-up
+// (1024 cycles, ~51 us), up to 4 ticks for the scan to reach the key's row and
+// KEY_DEBOUNCE_TICKS ticks of debounce: under 10 ms, as when awake.
+void idleSleep() {
+    HAL_Sleep();
+    // Timer1 stopped with the oscillator, so the software clock is behind by however
+    // long the core slept. Reload it from the DS1302 without counting that as drift.
+    clockSynced = 0;
+    clockResyncDue = 1;
+    idleSince = ticksNow();
+}
+
+// ------------------ Daily User Totals Functions ------------------
+// Each directory user has one 8-byte record on the totals EEPROM:
+//   [0..1] day  [2..4] seconds  [5] visits  [6..7] check  (LSB first)
+// An exit reads and rewrites that one record, so the totals are always current and
+// never need the log replayed. A visit counts towards the day it began (a night
+// shift belongs to the evening it started), and a record from an earlier day is
+// started over, which is the daily rollover.
+// Records are in directory order, so adding or removing a user moves everyone after
+// them to another record. The check covers the roll number the record was written
+// for: a record left by whoever had the slot before fails it and reads as no visits.
+unsigned int totalsCheck(unsigned int id, const unsigned char* rec) {
+    unsigned int crc = protoCrc16(protoCrc16(PROTO_CRC_INIT, (unsigned char)id), (unsigned char)(id >> 8));
+    for (unsigned char i = 0; i < TOTALS_CHECK; i++) crc = protoCrc16(crc, rec[i]);
+    return crc;
+}
+// Read a user's record and where it is. Returns TOT_OK, TOT_UNKNOWN (not in the
+// directory, or past what the chip holds) or TOT_NO_EEPROM (the chip did not answer,
+// now or at boot).
+// A missing, torn or other user's record reads as no visits.
+unsigned char totalsRead(unsigned int id, UserTotals* t, unsigned int* addr) {
+    t->day = 0xFFFF;
+    t->seconds = 0;
+    t->visits = 0;
+    int index = userIndex(id);
+    if (index < 0 || index >= TOTALS_MAX_USERS) return TOT_UNKNOWN;
+    if (totalsChipMissing) return TOT_NO_EEPROM;
+    *addr = TOTALS_BASE + (unsigned int)index * TOTALS_RECORD_SIZE;
+    unsigned char rec[TOTALS_RECORD_SIZE];
+    if (!HAL_ExtEeRead(*addr, rec, TOTALS_RECORD_SIZE)) return TOT_NO_EEPROM;
+    unsigned int check = totalsCheck(id, rec);
+    if (rec[TOTALS_CHECK] != (unsigned char)check || rec[TOTALS_CHECK + 1] != (unsigned char)(check >> 8)) return TOT_OK;
+    unsigned int day = rec[0] | ((unsigned int)rec[1] << 8);
+    if (day == 0xFFFF) return TOT_OK; // Erased, whatever the check happens to say
+    t->day = day;
+    t->seconds = rec[2] | ((unsigned int)rec[3] << 8) | ((unsigned long)rec[4] << 16);
+    t->visits = rec[5];
+    return TOT_OK;
+}
+// Add a finished visit to the totals of the day it began (see clockDayOf)
+void totalsAdd(unsigned int id, unsigned int day, unsigned long seconds) {
+    UserTotals t;
+    unsigned int addr;
+    if (totalsRead(id, &t, &addr) != TOT_OK) return; // Unknown user, or no chip to write to
+    if (t.day != day) { t.day = day; t.seconds = 0; t.visits = 0; } // New day: start from zero
+    t.seconds = (seconds < TOTALS_MAX_SECONDS - t.seconds) ? t.seconds + seconds : TOTALS_MAX_SECONDS;
+    if (t.visits < 255) t.visits++;
+
+    unsigned char rec[TOTALS_RECORD_SIZE];
+    rec[0] = (unsigned char)t.day;
+    rec[1] = (unsigned char)(t.day >> 8);
+    for (unsigned char i = 0; i < 3; i++) rec[2 + i] = (unsigned char)(t.seconds >> (i * 8));
+    rec[5] = t.visits;
+    unsigned int check = totalsCheck(id, rec);
+    rec[TOTALS_CHECK] = (unsigned char)check;
+    rec[TOTALS_CHECK + 1] = (unsigned char)(check >> 8);
+    HAL_ExtEeWrite(addr, rec, TOTALS_RECORD_SIZE); // One page write; the chip finishes it on its own
+}
+// Report screen: "2301 VISITS: 3" / "TODAY 03:15:22" (finished visits that began today)
+void showUserTotals(unsigned int id) {
+    UserTotals t;
+    unsigned int addr;
+    unsigned char status = totalsRead(id, &t, &addr);
+    if (status != TOT_OK) {
+        Send2Lcd(0x80, "    ERROR!      "); // 16 Chars Centered
+        Send2Lcd(0xC0, status == TOT_UNKNOWN ? "  INVALID ID    " : " TOTALS EEPROM  "); // 16 Chars
+        showFor(1000, UI_IDLE);
+        return;
+    }
+    ClockSnapshot now;
+    clockRead(&now);
+    if (t.day != now.dayNumber) { t.seconds = 0; t.visits = 0; } // Nothing finished today yet
+
+    char text[11];
+    text[formatDigits(id, 4, text)] = '\0';
+    unsigned char col = LCD_Print(0, 0, text);
+    col = LCD_Print(0, col, " VISITS: ");
+    text[formatDigits(t.visits, 1, text)] = '\0';
+    padLine(0x80, LCD_Print(0, col, text));
+
+    formatDuration(t.seconds, text);
+    col = LCD_Print(1, 0, "TODAY ");
+    padLine(0xC0, LCD_Print(1, col, text)); // 8-10 Chars, pad the rest
+    showFor(2000, UI_IDLE);
 }
@@ -0,0 +1,33 @@
+// User directory image for an external 24LC256 (32 KB I2C serial EEPROM).
+// Shared by the firmware (built with USER_DIRECTORY_EXTERNAL=1) and tools/dir_image.
+//
+// 0x0000          header, one page
+// DIR_FENCE_ADDR  fence: the first ID of every index page, 2 bytes each
+// index           [ID][name address] entries sorted by ID, DIR_ENTRIES_PER_PAGE to a
+//                 page, starting on a page boundary
+// names           pool of NUL-terminated names, packed back to back
+// A lookup binary-searches the fence for the one index page that can hold the ID,
+// then that page, and reads the name from the address next to the ID. A user
+// costs 4 bytes of index plus the name and its terminator, so about 2,900 users
+// with 6-letter names fit.
+// Multi-byte fields are little-endian, like the EEPROM records.
+#ifndef DIRECTORY_H
+#define DIRECTORY_H
+
+#define DIR_DEVICE_SIZE 32768
+#define DIR_PAGE_SIZE 64
+#define DIR_ENTRY_SIZE 4          // [2] ID, [2] name address
+#define DIR_ENTRIES_PER_PAGE 16
+#define DIR_FENCE_ADDR 0x0040
+
+// --- Header ---
+#define DIR_HDR_MAGIC 0           // [2] 'U', 'D'
+#define DIR_HDR_VERSION 2         // [1] DIR_VERSION
+#define DIR_HDR_COUNT 3           // [2] Users
+#define DIR_HDR_PAGES 5           // [2] Index pages (= fence entries)
+#define DIR_HDR_INDEX 7           // [2] Address of the first index page
+#define DIR_HDR_NAMES 9           // [2] Address of the name pool
+#define DIR_HEADER_SIZE 11
+#define DIR_VERSION 2
+
+#endif
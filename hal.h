@@ -0,0 +1,76 @@
+// Hardware abstraction for the attendance terminal.
+// attendence.c only talks to the board through these calls, so the same logic
+// builds for the PIC16F877A (hal_pic16.c) and for the Linux host simulator
+// (host/hal_host.c, built with -DHAL_HOST).
+#ifndef HAL_H
+#define HAL_H
+
+// --- Board bring-up ---
+void HAL_Init();              // Port directions, pull-ups, all control lines idle
+void HAL_StartInterrupts();   // 1 ms tick, 100 ms clock tick and EEPROM completion, then GIE
+
+// --- Interrupt masking ---
+unsigned char HAL_IrqDisable();        // Global disable, returns the previous state
+void HAL_IrqRestore(unsigned char on); // Put back what HAL_IrqDisable returned
+void HAL_TickIrq(unsigned char on);    // 1 ms tick interrupt (Timer0) on/off
+void HAL_ClockIrq(unsigned char on);   // 100 ms clock interrupt (CCP1) on/off
+void HAL_ClockRestart();               // Restart the current 100 ms period
+
+// --- Keypad (4 rows driven low one at a time, 4 columns with pull-ups) ---
+void HAL_KeypadSelectRow(unsigned char row);
+unsigned char HAL_KeypadColumns(); // Column nibble, active low (0x0F = nothing pressed)
+
+// --- HD44780 LCD, 8-bit bus ---
+void HAL_LcdWrite(unsigned char rs, unsigned char value); // Instruction (rs=0) or data (rs=1)
+unsigned char HAL_LcdBusy(); // One busy-flag read
+
+// --- DS1302 RTC (one call = one RST-framed transaction) ---
+void HAL_RtcWrite(unsigned char cmd, unsigned char data);
+unsigned char HAL_RtcRead(unsigned char cmd);
+void HAL_RtcReadBurst(unsigned char cmd, unsigned char* buf, unsigned char len);
+
+// --- Data EEPROM ---
+unsigned char HAL_EeRead(unsigned char addr); // Waits out a running write
+void HAL_EeWrite(unsigned char addr, unsigned char data); // Starts a write; completion raises HAL_OnEeDone()
+
+// --- External EEPROM (two 24LC256 on the MSSP I2C bus, 400 kHz) ---
+// Address bit 15 picks the chip: 0x0000-0x7FFF is A0 low (user directory image),
+// 0x8000-0xFFFF is A0 high (daily user totals). A chip still busy with a write is
+// polled until it answers, so a transaction may first wait up to ~5 ms. Both return 0
+// if the chip never answered (not fitted): reads then come back as 0xFF.
+unsigned char HAL_ExtEeRead(unsigned int addr, unsigned char* buf, unsigned char len); // One random-read transaction
+unsigned char HAL_ExtEeWrite(unsigned int addr, const unsigned char* buf, unsigned char len); // One page write, within a 64-byte page
+unsigned char HAL_ExtEeIdle(unsigned int addr); // One control byte, no retries: 1 if the chip answers (no write cycle running)
+
+// --- USART (115200 8N1) ---
+void HAL_UartTxIrq(unsigned char on);      // Transmit-buffer-empty interrupt on/off
+void HAL_UartTxByte(unsigned char data);   // Load the transmit buffer (only when it is empty)
+
+// --- Sleep ---
+// Drive every keypad row low, arm the RB4-RB7 interrupt-on-change and SLEEP until a
+// key pulls a column low (returns at once if one already is). The oscillator stops:
+// Timer0, Timer1 and the USART halt until the wake-up, and the row scan resumes where
+// it was. Call only with no EEPROM write or USART transmission in progress.
+void HAL_Sleep();
+
+// --- Data placement ---
+// PIC16 RAM is four banks and an object never spans two. HAL_BANK(n) pins a variable
+// to bank n (XC8 honours it with --addrqual=require); elsewhere it means nothing.
+#ifdef HAL_HOST
+#define HAL_BANK(n)
+#else
+#define HAL_BANK(n) __bank(n)
+#endif
+
+// --- Delays ---
+void delay_ms(unsigned int ms);
+void delay_us(unsigned int us);
+
+// --- Interrupt handlers, implemented by the application ---
+void HAL_OnTick();     // Every 1 ms
+void HAL_OnClockTick(); // Every 100 ms
+void HAL_OnEeDone();   // EEPROM byte write finished
+void HAL_OnUartTx();   // USART transmit buffer empty (only while HAL_UartTxIrq is on)
+void HAL_OnUartRx(unsigned char data); // USART received a byte
+
+#endif
@@ -0,0 +1,343 @@
+// PIC16F877A implementation of hal.h (XC8). Everything that touches an SFR lives here.
+#include <xc.h>
+#include "hal.h"
+
+#pragma config FOSC = HS      // Oscillator Selection bits (HS oscillator)
+#pragma config WDTE = OFF     // Watchdog Timer Enable bit (WDT disabled)
+#pragma config PWRTE = ON     // Power-up Timer Enable bit (PWRT enabled)
+#pragma config CP = OFF       // FLASH Program Memory Code Protection bit (Code protection off)
+#pragma config BOREN = OFF    // Brown-out Reset Enable bit (BOR disabled)
+#pragma config LVP = OFF      // Low-Voltage (Single-Supply) In-Circuit Serial Programming Enable bit (RB3 is digital I/O, HV on MCLR must be used for programming)
+#pragma config CPD = OFF      // Data EEPROM Memory Code Protection bit (Data EEPROM code protection off)
+#pragma config WRT = OFF      // Flash Program Memory Write Enable bits (Write protection off; all program memory may be written to by EECON control)
+
+#define _XTAL_FREQ 20000000
+
+// DS1302 pin mapping
+#define DS1302_RST  RA0
+#define DS1302_IO   RA1
+#define DS1302_CLK  RA2
+
+// LCD pin mapping
+#define LCD_RS RC1
+#define LCD_RW RC0
+#define LCD_E  RC2
+#define LCD_PORT PORTD
+
+// --- Timers ---
+#define TMR0_PRELOAD (256 - 156)  // Fosc/4 = 5 MHz, 1:32 prescale -> 156 counts ~ 1 ms tick
+#define CCP1_PERIOD 62500         // Timer1 at Fosc/4 / 8 = 625 kHz -> 62500 counts = 100 ms
+
+// --- Interrupt Service Routine ---
+// GIE is cleared by hardware on entry and restored by RETFIE, so it must not be touched here.
+void __interrupt() isr() {
+    if (INTCONbits.TMR0IF) { // 1 ms system tick
+        TMR0 = TMR0_PRELOAD;
+        INTCONbits.TMR0IF = 0;
+        HAL_OnTick();
+    }
+    if (PIR1bits.CCP1IF) { // 100 ms clock tick (Timer1 is reset by the special event trigger)
+        PIR1bits.CCP1IF = 0;
+        HAL_OnClockTick();
+    }
+    if (PIR2bits.EEIF) { // Previous EEPROM byte write finished
+        PIR2bits.EEIF = 0;
+        HAL_OnEeDone();
+    }
+    if (PIR1bits.RCIF) { // Byte received (reading RCREG clears RCIF)
+        if (RCSTAbits.OERR) { RCSTAbits.CREN = 0; RCSTAbits.CREN = 1; } // Overrun stops the receiver until CREN is cycled
+        HAL_OnUartRx(RCREG);
+    }
+    if (PIE1bits.TXIE && PIR1bits.TXIF) { // TXREG empty (TXIF clears when TXREG is loaded)
+        HAL_OnUartTx();
+    }
+}
+
+// ------------------ Board Setup ------------------
+void HAL_Init() {
+    // --- Port Initialization ---
+    TRISA = 0x02;  // RA1 (DS1302_IO) needs input capability. Others output.
+    TRISC = 0xD8;  // RC0-RC2 (LCD Control) -> Output, RC3/RC4 to the MSSP, RC6/RC7 to the USART
+    TRISD = 0x00;  // PORTD (LCD Data) -> Output
+    TRISB = 0xF0;  // RB7-RB4 (Keypad Cols) -> Input, RB3-RB0 (Keypad Rows) -> Output
+    PORTB = 0b11111110; // Scanner starts on Row 0
+
+    // --- Peripheral Setup ---
+    ADCON1 = 0x06; // Configure PORTA pins as digital I/O on PIC16F877A
+    OPTION_REGbits.nRBPU = 0; // Enable PORTB pull-ups for keypad columns
+
+    // --- USART: 115200 8N1, transmit interrupt enabled only while there is data ---
+    SPBRG = 10;                // 20 MHz / (16 * (10 + 1)) = 113636 baud (-1.4%)
+    TXSTAbits.BRGH = 1;
+    TXSTAbits.SYNC = 0;
+    RCSTAbits.SPEN = 1;
+    TXSTAbits.TXEN = 1;
+    RCSTAbits.CREN = 1;
+
+    // --- MSSP: I2C master, 400 kHz, for the external directory EEPROM ---
+    SSPCON = 0x28;             // SSPEN, I2C master mode
+    SSPCON2 = 0x00;
+    SSPADD = 11;               // 20 MHz / (4 * (11 + 1)) = 417 kHz
+    SSPSTAT = 0x00;            // Slew-rate control on (400 kHz mode)
+
+    LCD_E = 0; LCD_RS = 0; LCD_RW = 0;
+    DS1302_RST = 0; DS1302_CLK = 0; DS1302_IO = 0;
+    TRISA &= ~((1 << 0) | (1 << 1) | (1 << 2)); // RST, CLK and IO start as outputs
+}
+
+void HAL_StartInterrupts() {
+    // --- Timer1 + CCP1 special event: 100 ms software clock tick ---
+    // In special event mode CCP1 resets Timer1 on match and leaves the RC2 pin
+    // (LCD_E) alone, so the period has no reload jitter.
+    T1CON = 0x30;             // 1:8 prescale, internal clock, Timer1 off
+    TMR1H = 0; TMR1L = 0;
+    CCPR1H = CCP1_PERIOD >> 8;
+    CCPR1L = CCP1_PERIOD & 0xFF;
+    CCP1CON = 0x0B;           // Compare mode, trigger special event
+    PIR1bits.CCP1IF = 0;
+    PIE1bits.CCP1IE = 1;
+    INTCONbits.PEIE = 1;
+    T1CONbits.TMR1ON = 1;
+
+    // --- Data EEPROM: EEIF paces the queued writes ---
+    PIR2bits.EEIF = 0;
+    PIE2bits.EEIE = 1;
+
+    // --- USART receive: host frames are parsed byte by byte in the ISR ---
+    PIE1bits.RCIE = 1;
+
+    // --- Timer0: 1 ms tick for the keypad scanner and timed screens ---
+    OPTION_REGbits.T0CS = 0; // Internal instruction clock
+    OPTION_REGbits.PSA = 0;  // Prescaler assigned to Timer0
+    OPTION_REGbits.PS = 0b100; // 1:32
+    TMR0 = TMR0_PRELOAD;
+    INTCONbits.TMR0IF = 0;
+    INTCONbits.TMR0IE = 1;
+    INTCONbits.GIE = 1;
+}
+
+// ------------------ Interrupt Masking ------------------
+unsigned char HAL_IrqDisable() {
+    unsigned char gie = INTCONbits.GIE;
+    INTCONbits.GIE = 0;
+    return gie;
+}
+void HAL_IrqRestore(unsigned char on) { INTCONbits.GIE = on; }
+void HAL_TickIrq(unsigned char on) { INTCONbits.TMR0IE = on; }
+void HAL_ClockIrq(unsigned char on) { PIE1bits.CCP1IE = on; }
+void HAL_ClockRestart() { TMR1H = 0; TMR1L = 0; }
+
+// ------------------ Keypad ------------------
+void HAL_KeypadSelectRow(unsigned char row) {
+    PORTB = (unsigned char)~(1 << row); // Activate row (RBn=0)
+}
+unsigned char HAL_KeypadColumns() { return PORTB >> 4; }
+
+// ------------------ Sleep ------------------
+// GIE stays off throughout: RBIE alone wakes the core, which then carries on after
+// SLEEP instead of vectoring, so a press between the check and SLEEP cannot be lost
+// to the ISR (SLEEP completes as a NOP if RBIF is already set).
+void HAL_Sleep() {
+    while (!TXSTAbits.TRMT); // Last stop bit out of the shift register
+    unsigned char gie = HAL_IrqDisable();
+    unsigned char rows = PORTB & 0x0F;
+    PORTB = 0xF0;            // All rows low: any key pulls its column low
+    delay_us(10);            // Let the columns settle through the pull-ups
+    if ((PORTB & 0xF0) == 0xF0) { // Reading PORTB also latches it for the mismatch
+        INTCONbits.RBIF = 0;
+        INTCONbits.RBIE = 1;
+        SLEEP();
+        NOP();               // Executed on wake-up, after the oscillator start-up timer
+        INTCONbits.RBIE = 0;
+        (void)PORTB;         // End the mismatch before clearing the flag
+        INTCONbits.RBIF = 0;
+    }
+    PORTB = 0xF0 | rows;     // Back to the row the scanner was on
+    HAL_IrqRestore(gie);
+}
+
+// ------------------ LCD Bus ------------------
+// Raw bus write: latch value into the instruction (rs=0) or data (rs=1) register
+void HAL_LcdWrite(unsigned char rs, unsigned char value) {
+    LCD_RS = rs; LCD_RW = 0; LCD_PORT = value;
+    LCD_E = 1; delay_us(1); LCD_E = 0;
+}
+// Read the busy flag (DB7) once
+unsigned char HAL_LcdBusy() {
+    unsigned char busy;
+    TRISD = 0xFF; // Data bus as input
+    LCD_RS = 0; LCD_RW = 1;
+    LCD_E = 1; delay_us(1);
+    busy = RD7;
+    LCD_E = 0; delay_us(1);
+    LCD_RW = 0;
+    TRISD = 0x00; // Data bus back to output
+    return busy;
+}
+
+// ------------------ DS1302 Bus ------------------
+void DS1302_WriteByte(unsigned char data) {
+     TRISA &= ~(1 << 1); // IO as output
+    for (char i = 0; i < 8; i++) {
+        DS1302_IO = (data >> i) & 1;
+        delay_us(1); DS1302_CLK = 1; delay_us(1); DS1302_CLK = 0; delay_us(1);
+    }
+}
+// Clock in one byte, LSB first. IO must already be an input, so a burst can
+// read several bytes back to back without fighting the DS1302 for the line.
+unsigned char DS1302_ReadByte() {
+    unsigned char value = 0;
+    for (char i = 0; i < 8; i++) {
+        if (DS1302_IO) value |= (1 << i);
+        DS1302_CLK = 1; delay_us(1); DS1302_CLK = 0; delay_us(1);
+    }
+    return value;
+}
+void HAL_RtcWrite(unsigned char cmd, unsigned char data) {
+    DS1302_RST = 1; delay_us(4);
+    DS1302_WriteByte(cmd); DS1302_WriteByte(data);
+    DS1302_RST = 0; delay_us(4);
+}
+unsigned char HAL_RtcRead(unsigned char cmd) {
+    unsigned char data;
+    HAL_RtcReadBurst(cmd, &data, 1);
+    return data;
+}
+// Read len bytes after one command (a single register or a burst)
+void HAL_RtcReadBurst(unsigned char cmd, unsigned char* buf, unsigned char len) {
+    DS1302_RST = 1; delay_us(4);
+    DS1302_WriteByte(cmd | 0x01); // Read command
+    TRISA |= (1 << 1); delay_us(1); // IO as input
+    for (unsigned char i = 0; i < len; i++) { buf[i] = DS1302_ReadByte(); }
+    TRISA &= ~(1 << 1); DS1302_IO = 0; // IO back to output low
+    DS1302_RST = 0; delay_us(4); // Dropping RST ends a burst early
+}
+
+// ------------------ Data EEPROM ------------------
+unsigned char HAL_EeRead(unsigned char addr) {
+    unsigned char gie = INTCONbits.GIE;
+    unsigned char value;
+    while (1) {
+        INTCONbits.GIE = 0;
+        if (!EECON1bits.WR) break; // No write running, the registers are ours
+        INTCONbits.GIE = gie;      // Let the write (and its EEIF) finish
+    }
+    EEADR = addr;
+    EECON1bits.EEPGD = 0; // Data memory
+    EECON1bits.RD = 1;
+    value = EEDATA;
+    INTCONbits.GIE = gie;
+    return value;
+}
+// Start a byte write. Runs with interrupts off (the unlock sequence must not be split).
+void HAL_EeWrite(unsigned char addr, unsigned char data) {
+    EEADR = addr;
+    EEDATA = data;
+    EECON1bits.EEPGD = 0; // Data memory
+    EECON1bits.WREN = 1;
+    EECON2 = 0x55;        // Required unlock sequence
+    EECON2 = 0xAA;
+    EECON1bits.WR = 1;
+    EECON1bits.WREN = 0;  // WR stays set until the cell is written; EEIF follows
+}
+
+// ------------------ 24LC256 (MSSP I2C master) ------------------
+#define EXT_EE_CONTROL 0xA0 // 1010 + A2..A0, R/W in bit 0
+#define EXT_EE_POLLS 250    // Control byte tries (~27 us each) before giving up on a busy chip
+
+// Wait until the MSSP has finished the current start/stop/ack/byte
+static void i2cIdle() {
+    while ((SSPCON2 & 0x1F) || SSPSTATbits.R_nW);
+}
+static void i2cSend(unsigned char data) {
+    i2cIdle();
+    SSPBUF = data;
+}
+// Start a write to addr: the chip NACKs its control byte while an earlier write is
+// still being programmed, so keep asking. Returns 0 if it never answers (no chip).
+static unsigned char extEeStart(unsigned int addr) {
+    unsigned char control = EXT_EE_CONTROL | ((addr >> 14) & 0x02); // Address bit 15 -> A0
+    for (unsigned char tries = 0; tries < EXT_EE_POLLS; tries++) {
+        i2cIdle();
+        SSPCON2bits.SEN = 1;
+        i2cSend(control);
+        i2cIdle();
+        if (!SSPCON2bits.ACKSTAT) {
+            i2cSend((unsigned char)(addr >> 8) & 0x7F);
+            i2cSend((unsigned char)addr);
+            return 1;
+        }
+        SSPCON2bits.PEN = 1;
+    }
+    return 0;
+}
+// Random read: set the address with a dummy write, then restart and read len bytes
+unsigned char HAL_ExtEeRead(unsigned int addr, unsigned char* buf, unsigned char len) {
+    if (!extEeStart(addr)) {
+        while (len--) *buf++ = 0xFF; // Reads like an erased chip
+        i2cIdle();
+        return 0;
+    }
+    i2cIdle();
+    SSPCON2bits.RSEN = 1;
+    i2cSend(EXT_EE_CONTROL | ((addr >> 14) & 0x02) | 1);
+    while (len--) {
+        i2cIdle();
+        SSPCON2bits.RCEN = 1;
+        while (!SSPSTATbits.BF);
+        *buf++ = SSPBUF;
+        SSPCON2bits.ACKDT = len ? 0 : 1; // NACK the last byte
+        SSPCON2bits.ACKEN = 1;
+    }
+    i2cIdle();
+    SSPCON2bits.PEN = 1;
+    i2cIdle();
+    return 1;
+}
+// Page write: the stop condition starts the chip's ~5 ms write cycle, which the
+// next transaction's extEeStart() waits out
+unsigned char HAL_ExtEeWrite(unsigned int addr, const unsigned char* buf, unsigned char len) {
+    if (!extEeStart(addr)) {
+        i2cIdle();
+        return 0;
+    }
+    while (len--) i2cSend(*buf++);
+    i2cIdle();
+    SSPCON2bits.PEN = 1;
+    i2cIdle();
+    return 1;
+}
+// Ask once: a chip still programming a page NACKs its control byte
+unsigned char HAL_ExtEeIdle(unsigned int addr) {
+    i2cIdle();
+    SSPCON2bits.SEN = 1;
+    i2cSend(EXT_EE_CONTROL | ((addr >> 14) & 0x02));
+    i2cIdle();
+    unsigned char answered = !SSPCON2bits.ACKSTAT;
+    SSPCON2bits.PEN = 1;
+    i2cIdle();
+    return answered;
+}
+
+// ------------------ USART ------------------
+void HAL_UartTxIrq(unsigned char on) { PIE1bits.TXIE = on; }
+void HAL_UartTxByte(unsigned char data) { TXREG = data; }
+
+// ------------------ Delay Functions (Optimized slightly for 20MHz) ------------------
+
+void delay_ms(unsigned int ms) {
+    while(ms--) {
+
+        volatile unsigned int i;
+        // The exact count (1660) depends on compiler, adjust if needed
+        for(i = 0; i < 1660; i++);
+     }
+}
+
+void delay_us(unsigned int us) {
+
+     while(us--) {
+        _nop(); _nop(); _nop(); // ~3 cycles
+
+     }
+}
@@ -0,0 +1,292 @@
+// Formatting kernel benchmark: the firmware's division-free formatDigits(), formatDuration()
+// and BCD clock fields against the / and % versions they replaced, in PIC16 cycles.
+//
+//   bench_format
+//
+// The host CPU turns a divide by a constant into a multiply, so host timing says
+// nothing about the PIC. Instead both versions are replayed here with every operation
+// charged at the cost of the XC8 code it becomes (the CY_ table: library divide and
+// multiply calls from their loop lengths, inline steps from the instructions they
+// take). The costed copy of the new code is checked against the firmware's output on
+// every input, so the two cannot drift apart. For exact figures run the same inputs
+// through the MPLAB X simulator's stopwatch.
+//
+// Before the table, the firmware kernels are checked: formatDigits() against printf
+// for every 16-bit value, formatDuration() against the old divide-based version, and
+// the BCD conversions both ways. Exits 1 on any mismatch.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+unsigned char BCD_to_Dec(unsigned char bcd);
+unsigned char Dec_to_BCD(unsigned char dec);
+unsigned char bcdIncrement(unsigned char bcd);
+void putBcd(unsigned char bcd, char* out);
+unsigned char formatDigits(unsigned int value, unsigned char width, char* out);
+unsigned char formatDuration(unsigned long secs, char* out);
+
+// --- PIC16 cost model (instruction cycles, call and return included) ---
+#define CY_DIV8 70    // ___lbdiv / ___lbmod: 8 shift-and-subtract rounds
+#define CY_DIV16 230  // ___lwdiv / ___lwmod: 16 rounds
+#define CY_DIV32 850  // ___lldiv / ___llmod: 32 rounds
+#define CY_MUL16 190  // ___wmul
+#define CY_MUL32 600  // ___lmul
+#define CY_STEP8 5    // 8-bit compare, subtract and set a bit
+#define CY_STEP16 11  // 16-bit compare and subtract
+#define CY_STEP32 22  // 32-bit compare and subtract
+#define CY_SHIFT16 4
+#define CY_SHIFT32 8
+#define CY_DIGIT 5    // Add '0' and store through FSR
+#define CY_NIBBLE 3   // SWAPF/ANDLW to split a BCD byte
+#define CY_CALL 4
+
+static unsigned long cycles;
+#define COST(c) (cycles += (c))
+
+// --- Before: / and % (costed copies of the replaced code) ---
+static void oldClock(unsigned char hour, unsigned char min, unsigned char sec, char* s) {
+    COST(CY_CALL + 6 * (CY_DIV8 + CY_DIGIT));
+    s[0] = (hour / 10) + '0'; s[1] = (hour % 10) + '0'; s[2] = ':';
+    s[3] = (min / 10) + '0'; s[4] = (min % 10) + '0'; s[5] = ':';
+    s[6] = (sec / 10) + '0'; s[7] = (sec % 10) + '0'; s[8] = '\0';
+}
+static unsigned char oldNumber(unsigned int value, char* out) {
+    char digits[5];
+    unsigned char len = 0;
+    COST(CY_CALL);
+    do { COST(2 * CY_DIV16 + CY_DIGIT); digits[len++] = (value % 10) + '0'; value /= 10; } while (value);
+    for (unsigned char i = 0; i < len; i++) { COST(CY_DIGIT); out[i] = digits[len - 1 - i]; }
+    return len;
+}
+static void oldRoll(unsigned int id, char* out) {
+    COST(CY_CALL);
+    for (unsigned char i = 4; i--; ) { COST(2 * CY_DIV16 + CY_DIGIT); out[i] = (id % 10) + '0'; id /= 10; }
+    out[4] = '\0';
+}
+static unsigned char oldCount(unsigned char count, char* out) { // The A and B handlers' inline version
+    unsigned char len;
+    if (count < 10) { COST(CY_DIGIT); out[0] = count + '0'; len = 1; }
+    else { COST(2 * (CY_DIV8 + CY_DIGIT)); out[0] = (count / 10) + '0'; out[1] = (count % 10) + '0'; len = 2; }
+    out[len] = '\0';
+    return len;
+}
+static unsigned char oldDuration(unsigned long secs, char* out) {
+    COST(CY_CALL + 2 * (CY_DIV32 + CY_MUL32) + CY_DIV16 + CY_MUL16);
+    unsigned long days = secs / 86400UL;
+    unsigned long rest = secs - days * 86400UL;
+    unsigned char hours = (unsigned char)(rest / 3600u);
+    unsigned int inHour = (unsigned int)(rest - hours * 3600UL);
+    unsigned char minutes = (unsigned char)(inHour / 60u);
+    unsigned char len = 0;
+    if (days) {
+        if (days > 999) { days = 999; hours = 23; minutes = 59; }
+        len = oldNumber((unsigned int)days, out);
+        out[len++] = 'd';
+        out[len++] = ' ';
+    }
+    COST(4 * (CY_DIV8 + CY_DIGIT));
+    out[len++] = (hours / 10) + '0'; out[len++] = (hours % 10) + '0'; out[len++] = ':';
+    out[len++] = (minutes / 10) + '0'; out[len++] = (minutes % 10) + '0';
+    if (!days) {
+        COST(CY_MUL16 + 2 * (CY_DIV8 + CY_DIGIT));
+        unsigned char seconds = (unsigned char)(inHour - minutes * 60u);
+        out[len++] = ':'; out[len++] = (seconds / 10) + '0'; out[len++] = (seconds % 10) + '0';
+    }
+    out[len] = '\0';
+    return len;
+}
+
+// --- After: BCD and ladders (costed copies of the firmware kernels) ---
+static const unsigned int ladder[11] = { 40000, 20000, 10000, 8000, 4000, 2000, 1000, 800, 400, 200, 100 };
+
+static unsigned char newBcd(unsigned char dec) {
+    unsigned char tens = 0;
+    COST(CY_CALL + 2 + 4 * CY_STEP8);
+    if (dec > 99) dec = 99;
+    if (dec >= 80) { dec -= 80; tens = 0x80; }
+    if (dec >= 40) { dec -= 40; tens |= 0x40; }
+    if (dec >= 20) { dec -= 20; tens |= 0x20; }
+    if (dec >= 10) { dec -= 10; tens |= 0x10; }
+    return tens | dec;
+}
+static void newPutBcd(unsigned char bcd, char* out) {
+    COST(CY_CALL + CY_NIBBLE + 2 * CY_DIGIT);
+    out[0] = (bcd >> 4) + '0'; out[1] = (bcd & 0x0F) + '0';
+}
+static void newClock(unsigned char hour, unsigned char min, unsigned char sec, char* s) {
+    COST(CY_CALL);
+    newPutBcd(hour, s); s[2] = ':';
+    newPutBcd(min, s + 3); s[5] = ':';
+    newPutBcd(sec, s + 6); s[8] = '\0';
+}
+static unsigned char newDigits(unsigned int value, unsigned char width, char* out) {
+    unsigned char len = 0;
+    COST(CY_CALL + 4);
+    if (value >= 100 || width > 2) {
+        unsigned char digit = 0, weight = 4, place = 5;
+        for (unsigned char i = 0; i < 11; i++) {
+            COST(CY_STEP16 + 3);
+            if (value >= ladder[i]) { value -= ladder[i]; digit |= weight; }
+            weight >>= 1;
+            if (!weight) {
+                COST(4);
+                if (digit || len || place <= width) { COST(CY_DIGIT); out[len++] = digit + '0'; }
+                digit = 0; weight = 8; place--;
+            }
+        }
+    }
+    unsigned char bcd = newBcd((unsigned char)value);
+    COST(CY_NIBBLE + 2 * CY_DIGIT);
+    if (len || bcd >= 0x10 || width >= 2) out[len++] = (bcd >> 4) + '0';
+    out[len++] = (bcd & 0x0F) + '0';
+    return len;
+}
+static unsigned int newDivide(unsigned long* rest, unsigned long unit, unsigned char bits) {
+    COST(CY_CALL + (bits - 1) * CY_SHIFT32);
+    unsigned long step = unit << (bits - 1);
+    unsigned int quotient = 0;
+    while (bits--) {
+        COST(CY_SHIFT16 + CY_STEP32 + CY_SHIFT32);
+        quotient <<= 1;
+        if (*rest >= step) { *rest -= step; quotient |= 1; }
+        step >>= 1;
+    }
+    return quotient;
+}
+static unsigned char newDuration(unsigned long secs, char* out) {
+    unsigned int days = 0;
+    unsigned char len = 0;
+    COST(CY_CALL + 2 * CY_STEP32);
+    if (secs >= 1000 * 86400UL) { days = 999; secs = 86399UL; }
+    else if (secs >= 86400UL) days = newDivide(&secs, 86400UL, 10);
+    unsigned char hours = (unsigned char)newDivide(&secs, 3600UL, 5);
+    unsigned char minutes = (unsigned char)newDivide(&secs, 60UL, 6);
+    if (days) {
+        len = newDigits(days, 1, out);
+        out[len++] = 'd';
+        out[len++] = ' ';
+    }
+    len += newDigits(hours, 2, out + len); out[len++] = ':';
+    len += newDigits(minutes, 2, out + len);
+    if (!days) { out[len++] = ':'; len += newDigits((unsigned char)secs, 2, out + len); }
+    out[len] = '\0';
+    return len;
+}
+
+// --- Checks ---
+static unsigned long failures;
+
+static void expectSame(const char* what, unsigned long input, const char* got, const char* want) {
+    if (!strcmp(got, want)) return;
+    if (failures++ < 10) printf("MISMATCH %s(%lu): got \"%s\", want \"%s\"\n", what, input, got, want);
+}
+
+static void checkKernels() {
+    char got[16], want[16];
+    for (unsigned int v = 0; v < 100; v++) {
+        unsigned char bcd = Dec_to_BCD((unsigned char)v);
+        if (bcd != ((v / 10) << 4 | (v % 10)) || BCD_to_Dec(bcd) != v) {
+            if (failures++ < 10) printf("MISMATCH BCD %u -> 0x%02X\n", v, bcd);
+        }
+        if (v && bcdIncrement(Dec_to_BCD((unsigned char)(v - 1))) != bcd) {
+            if (failures++ < 10) printf("MISMATCH bcdIncrement %u\n", v - 1);
+        }
+        putBcd(bcd, got); got[2] = '\0';
+        snprintf(want, sizeof(want), "%02u", v);
+        expectSame("putBcd", v, got, want);
+    }
+    static const unsigned char widths[] = { 1, 2, 4 };
+    for (unsigned long v = 0; v <= 0xFFFF; v++) {
+        for (unsigned int w = 0; w < sizeof(widths); w++) {
+            got[formatDigits((unsigned int)v, widths[w], got)] = '\0';
+            if (snprintf(want, sizeof(want), "%0*lu", widths[w], v) >= (int)sizeof(want)) { // Cannot happen for widths up to 4
+                if (failures++ < 10) printf("MISMATCH formatDigits(%lu): reference does not fit %u chars\n", v, (unsigned int)sizeof(want) - 1);
+                continue;
+            }
+            expectSame("formatDigits", v, got, want);
+            want[newDigits((unsigned int)v, widths[w], want)] = '\0';
+            expectSame("costed formatDigits", v, got, want);
+        }
+    }
+    unsigned long seed = 2301;
+    for (unsigned long i = 0; i < 400000; i++) {
+        unsigned long secs = i;                          // Every value up to about 4.6 days
+        if (i >= 200000) {                               // Then random ones over the full range
+            seed = seed * 1103515245UL + 12345UL;
+            secs = (seed >> 8) & 0xFFFFFFFFUL;
+            if (i & 1) secs %= 1100 * 86400UL;           // Around the 999-day cap
+        }
+        formatDuration(secs, got);
+        oldDuration(secs, want);
+        expectSame("formatDuration", secs, got, want);
+        newDuration(secs, want);
+        expectSame("costed formatDuration", secs, got, want);
+    }
+}
+
+// --- Cycle table ---
+typedef struct {
+    const char* name;
+    unsigned long oldCycles, newCycles, calls;
+} Row;
+
+static void printRow(Row* r) {
+    double before = (double)r->oldCycles / r->calls, after = (double)r->newCycles / r->calls;
+    printf("%-26s %10.0f %10.0f %7.1fx\n", r->name, before, after, before / after);
+}
+
+int main() {
+    checkKernels();
+    if (failures) { printf("%lu mismatches\n", failures); return 1; }
+    printf("kernels match: formatDigits (0-65535, widths 1/2/4), formatDuration (400000 inputs), BCD\n\n");
+
+    char out[16];
+    printf("%-26s %10s %10s %8s\n", "estimated PIC16 cycles", "before", "after", "speedup");
+    Row clock = { "clock HH:MM:SS", 0, 0, 0 };
+    for (unsigned char h = 0; h < 24; h++)
+        for (unsigned char m = 0; m < 60; m++)
+            for (unsigned char s = 0; s < 60; s++) {
+                cycles = 0; oldClock(h, m, s, out); clock.oldCycles += cycles;
+                // The snapshot already holds the DS1302's BCD, so the conversion is not charged
+                unsigned char hb = Dec_to_BCD(h), mb = Dec_to_BCD(m), sb = Dec_to_BCD(s);
+                cycles = 0; newClock(hb, mb, sb, out); clock.newCycles += cycles;
+                clock.calls++;
+            }
+    printRow(&clock);
+
+    Row count = { "count 0-99 (A, B keys)", 0, 0, 0 };
+    for (unsigned char n = 0; n < 100; n++, count.calls++) {
+        cycles = 0; oldCount(n, out); count.oldCycles += cycles;
+        cycles = 0; newDigits(n, 1, out); count.newCycles += cycles;
+    }
+    printRow(&count);
+
+    Row number = { "number 0-65535", 0, 0, 0 };
+    for (unsigned long n = 0; n <= 0xFFFF; n++, number.calls++) {
+        cycles = 0; oldNumber((unsigned int)n, out); number.oldCycles += cycles;
+        cycles = 0; newDigits((unsigned int)n, 1, out); number.newCycles += cycles;
+    }
+    printRow(&number);
+
+    Row roll = { "roll 0000-9999", 0, 0, 0 };
+    for (unsigned int n = 0; n < 10000; n++, roll.calls++) {
+        cycles = 0; oldRoll(n, out); roll.oldCycles += cycles;
+        cycles = 0; newDigits(n, 4, out); roll.newCycles += cycles;
+    }
+    printRow(&roll);
+
+    static const struct { const char* name; unsigned long from, to, step; } spans[] = {
+        { "duration under 1 h", 0, 3600, 1 },
+        { "duration under 1 day", 0, 86400, 7 },
+        { "duration 1-999 days", 86400, 1000 * 86400UL, 86413 },
+    };
+    for (unsigned int i = 0; i < sizeof(spans) / sizeof(spans[0]); i++) {
+        Row d = { spans[i].name, 0, 0, 0 };
+        for (unsigned long secs = spans[i].from; secs < spans[i].to; secs += spans[i].step, d.calls++) {
+            cycles = 0; oldDuration(secs, out); d.oldCycles += cycles;
+            cycles = 0; newDuration(secs, out); d.newCycles += cycles;
+        }
+        printRow(&d);
+    }
+    return 0;
+}
@@ -0,0 +1,372 @@
+// Keypress latency bench: replays a key trace through the firmware in virtual time
+// (keypad scan in the Timer0 ISR, key queue, processKey(), LCD flush) and reports
+// how long each key and each whole transaction takes to reach the screen, and
+// what it cost in LCD bytes, DS1302 transactions and blocking delays.
+//
+//   bench_keys [-x directory.bin] [--budget US] [--record OUT] TRACE
+//   bench_keys [-x directory.bin] [--budget US] [--record OUT] --generate N [--seed S]
+//
+// A trace is a simulator-style script:
+//   rtc YYYY-MM-DD HH:MM:SS   set the DS1302
+//   gap MS                    key-up time between the keys of the following lines (default 120)
+//   keys 2301#                one transaction: each key held KEY_HOLD_MS, then released for the gap
+//   expect LINE1|LINE2        golden LCD after the transaction (trailing spaces ignored, '?' matches any character)
+//   wait MS                   let time pass
+//   extee CHIP on|off         fit or pull the directory or totals 24LC256
+// --generate makes N transactions of a door at shift change (badges of a small crowd,
+// unknown and half-typed IDs, the A and B keys) and --record writes whatever ran, with
+// the LCD after every transaction as its expect line, so the output is a new golden
+// trace. For entries and exits it also reports the door's throughput: badges per
+// minute from the first one's first key to the last one's result, which is only
+// the door's pace when the trace has no waits (host/traces/door_rush.trace).
+// Exits 1 on a golden mismatch, or when the p99 from the last key of a
+// transaction to its result is over --budget microseconds.
+//
+// Latency is virtual time: the HAL's bus, LCD and delay costs plus POLL_US per main
+// loop pass. The CPU time of the firmware's own code is not modelled.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hal_host.h"
+#include "directory.h"
+
+void appInit();
+void appPoll();
+unsigned char lookupUser(unsigned int id, const char** name);
+extern volatile unsigned char keyHead, keyTail;
+
+#define POLL_US 20       // Virtual cost of one main loop pass, as in the simulator
+#define KEY_HOLD_MS 40   // How long a key stays down
+#define GAP_MS 120       // Default key-up time before the next key
+#define CROWD 16         // Users the generator badges in and out
+
+// --- Samples and percentiles ---
+typedef struct {
+    unsigned long long* v;
+    unsigned long n, cap;
+} Samples;
+
+static void addSample(Samples* s, unsigned long long us) {
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 64;
+        s->v = realloc(s->v, s->cap * sizeof(*s->v));
+        if (!s->v) { perror("realloc"); exit(2); }
+    }
+    s->v[s->n++] = us;
+}
+static int cmpUll(const void* a, const void* b) {
+    unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+static unsigned long long percentile(Samples* s, unsigned int pct) {
+    if (!s->n) return 0;
+    qsort(s->v, s->n, sizeof(*s->v), cmpUll);
+    unsigned long at = s->n * pct / 100;
+    return s->v[at < s->n ? at : s->n - 1];
+}
+
+// --- Per key: [0] down -> queued (scan and debounce), [1] queued -> taken by the main
+// loop, [2] the pass that handled it (processKey + LCD flush), [3] down -> shown ---
+static const char* stageNames[4] = { "scan", "queue", "service", "total" };
+static Samples keyStage[4];
+static unsigned long keyLcd, keyRtc;        // HAL work of the passes that handled keys
+static unsigned long long keyDelayUs;
+
+// --- Per transaction, by what it turned out to be: first key down -> last key shown
+// (what the person waits, typing included), and last key down -> shown (the terminal's share) ---
+enum { TX_ENTRY, TX_EXIT, TX_REJECTED, TX_INFO, TX_LIST, TX_RESET, TX_CLEAR, TX_PARTIAL, TX_KINDS };
+static const char* kindNames[TX_KINDS] = { "entry", "exit", "rejected", "info (A/C)", "list (B)", "reset (D)", "clear", "partial" };
+static Samples txLatency[TX_KINDS], txResult[TX_KINDS], txAll;
+static unsigned long txLcd[TX_KINDS], txRtc[TX_KINDS];
+static unsigned long long txDelayUs[TX_KINDS];
+static unsigned long long badgeFirstUs, badgeLastUs; // First key of the first entry or exit, result of the last
+
+static unsigned long goldenChecks, goldenFailures;
+static unsigned int gapMs = GAP_MS;
+static unsigned char booted = 0;
+static FILE* recordOut = NULL;
+
+// The key in flight: pressed at keyDownUs, queued at queuedUs, taken by a pass that ended at shownUs
+static unsigned char keyPending = 0, keyQueued = 0, keyHeadAtDown;
+static unsigned long long keyDownUs, queuedUs, shownUs;
+
+static void boot() {
+    if (booted) return;
+    appInit();
+    booted = 1;
+}
+
+// One main loop pass; the one that takes the pending key from the queue is measured
+static void pollOnce() {
+    unsigned char tail = keyTail;
+    SimHalCounters before, after;
+    simHalCounters(&before);
+    unsigned long long start = simNowUs();
+    appPoll();
+    simAdvance(POLL_US);
+    if (keyPending && keyTail != tail) {
+        simHalCounters(&after);
+        if (!keyQueued) { queuedUs = start; keyQueued = 1; } // Queued and taken between two passes
+        shownUs = simNowUs();
+        addSample(&keyStage[0], queuedUs - keyDownUs);
+        addSample(&keyStage[1], start - queuedUs);
+        addSample(&keyStage[2], shownUs - start);
+        addSample(&keyStage[3], shownUs - keyDownUs);
+        keyLcd += after.lcdWrites - before.lcdWrites;
+        keyRtc += after.rtcTransactions - before.rtcTransactions;
+        keyDelayUs += after.delayUs - before.delayUs;
+        keyPending = 0;
+    } else if (keyPending && !keyQueued && keyHead != keyHeadAtDown) {
+        queuedUs = simNowUs();
+        keyQueued = 1;
+    }
+}
+
+// Let ms of virtual time pass with the main loop running
+static void run(unsigned long ms) {
+    boot();
+    unsigned long long until = simNowUs() + ms * 1000ULL;
+    while (simNowUs() < until) {
+        if (simAsleep()) simAdvance(until - simNowUs()); // Halted until the deadline or a key
+        else pollOnce();
+    }
+}
+
+static void lcdText(char* out) { // "LINE1|LINE2", trailing spaces dropped from each
+    char line[2][17];
+    simLcdLine(0, line[0]);
+    simLcdLine(1, line[1]);
+    for (int r = 0; r < 2; r++) {
+        int n = 16;
+        while (n > 0 && line[r][n - 1] == ' ') n--;
+        line[r][n] = '\0';
+    }
+    sprintf(out, "%s|%s", line[0], line[1]);
+}
+
+static int kindOf(char firstKey, char lastKey) {
+    char line2[17];
+    simLcdLine(1, line2);
+    if (firstKey == 'D') return TX_RESET;
+    if (lastKey == '#') return !strncmp(line2, "ENTRY", 5) ? TX_ENTRY : !strncmp(line2, "EXIT", 4) ? TX_EXIT : TX_REJECTED;
+    if (lastKey == 'A' || lastKey == 'C') return TX_INFO;
+    if (lastKey == 'B') return TX_LIST;
+    if (lastKey == '*') return TX_CLEAR;
+    return TX_PARTIAL;
+}
+
+static int keysCommand(const char* keys, unsigned int lineNo) {
+    SimHalCounters before, after;
+    boot();
+    simHalCounters(&before);
+    unsigned long long firstDownUs = simNowUs();
+    const char* k;
+    for (k = keys; *k && *k != ' '; k++) {
+        keyHeadAtDown = keyHead;
+        keyDownUs = simNowUs();
+        if (!simKeyDown(*k)) { fprintf(stderr, "line %u: no key '%c'\n", lineNo, *k); return 0; }
+        keyPending = 1;
+        keyQueued = 0;
+        run(KEY_HOLD_MS);
+        simKeyUp();
+        if (k[1] && k[1] != ' ') run(gapMs);
+        while (keyPending) run(1); // A slow pass can still be working on it
+    }
+    simHalCounters(&after);
+    int kind = kindOf(keys[0], k[-1]);
+    if (kind == TX_ENTRY || kind == TX_EXIT) {
+        if (!txLatency[TX_ENTRY].n && !txLatency[TX_EXIT].n) badgeFirstUs = firstDownUs;
+        badgeLastUs = shownUs;
+    }
+    addSample(&txLatency[kind], shownUs - firstDownUs);
+    addSample(&txResult[kind], shownUs - keyDownUs);
+    addSample(&txAll, shownUs - keyDownUs);
+    txLcd[kind] += after.lcdWrites - before.lcdWrites;
+    txRtc[kind] += after.rtcTransactions - before.rtcTransactions;
+    txDelayUs[kind] += after.delayUs - before.delayUs;
+    run(gapMs); // The last key's gap: the result is what the person sees
+    return 1;
+}
+
+static unsigned char lcdMatches(const char* expected, const char* shown) {
+    for (; *expected && *shown; expected++, shown++) {
+        if (*expected != '?' && *expected != *shown) return 0;
+    }
+    return *expected == *shown;
+}
+
+static int command(char* line, unsigned int lineNo) {
+    char* arg = line;
+    while (*arg && *arg != ' ' && *arg != '\t') arg++;
+    if (*arg) *arg++ = '\0';
+    if (strcmp(line, "expect")) while (*arg == ' ' || *arg == '\t') arg++; // Leading spaces are screen text
+
+    if (!strcmp(line, "expect")) {
+        char shown[40];
+        lcdText(shown);
+        goldenChecks++;
+        if (!lcdMatches(arg, shown)) {
+            goldenFailures++;
+            fprintf(stderr, "line %u: expected |%s|, LCD shows |%s|\n", lineNo, arg, shown);
+        }
+        return 1; // Re-recorded after the keys, not copied
+    }
+    if (recordOut) fprintf(recordOut, "%s %s\n", line, arg);
+    if (!strcmp(line, "rtc")) {
+        unsigned long secs;
+        if (!simRtcParse(arg, &secs)) { fprintf(stderr, "line %u: bad time '%s'\n", lineNo, arg); return 0; }
+        simRtcSet(secs);
+    } else if (!strcmp(line, "gap")) {
+        gapMs = (unsigned int)strtoul(arg, NULL, 10);
+    } else if (!strcmp(line, "keys")) {
+        if (!keysCommand(arg, lineNo)) return 0;
+        if (recordOut) {
+            char shown[40];
+            lcdText(shown);
+            fprintf(recordOut, "expect %s\n", shown);
+        }
+    } else if (!strcmp(line, "wait")) {
+        run(strtoul(arg, NULL, 10));
+    } else if (!strcmp(line, "extee")) {
+        if (!simExtEeCommand(arg)) { fprintf(stderr, "line %u: bad chip '%s'\n", lineNo, arg); return 0; }
+    } else {
+        fprintf(stderr, "line %u: unknown command '%s'\n", lineNo, line);
+        return 0;
+    }
+    return 1;
+}
+
+static int replay(FILE* trace) {
+    char line[256];
+    unsigned int lineNo = 0;
+    while (fgets(line, sizeof(line), trace)) {
+        lineNo++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char* text = line;
+        while (*text == ' ' || *text == '\t') text++;
+        if (*text == '\0' || *text == '#') continue;
+        if (!command(text, lineNo)) return 0;
+    }
+    return 1;
+}
+
+// A door at shift change: a crowd of known users badging in and out, with unknown
+// and half-typed IDs, clock (A) and list (B) lookups mixed in
+static void generate(FILE* out, unsigned long count, unsigned long seed) {
+    unsigned int crowd[CROWD], known = 0;
+#if USER_DIRECTORY_EXTERNAL // Straight from the image: the firmware is not booted yet
+    const unsigned char* ee = simExtEeprom();
+    unsigned int users = ee[DIR_HDR_COUNT] | (ee[DIR_HDR_COUNT + 1] << 8);
+    unsigned int index = ee[DIR_HDR_INDEX] | (ee[DIR_HDR_INDEX + 1] << 8);
+    if (ee[DIR_HDR_MAGIC] != 'U') users = 0;
+    for (; known < CROWD && known < users; known++) { // Spread over the directory
+        unsigned int i = known * (users / CROWD + 1) % users;
+        unsigned int at = index + i / DIR_ENTRIES_PER_PAGE * DIR_PAGE_SIZE + i % DIR_ENTRIES_PER_PAGE * DIR_ENTRY_SIZE;
+        crowd[known] = ee[at] | (ee[at + 1] << 8);
+    }
+#else
+    const char* name;
+    for (unsigned int id = 1; id <= 9999 && known < CROWD; id++) { // Program-memory table: no bus time
+        if (lookupUser(id, &name)) crowd[known++] = id;
+    }
+#endif
+    srand((unsigned int)seed);
+    fprintf(out, "rtc 2026-10-16 08:00:00\n");
+    for (unsigned long i = 0; i < count; i++) {
+        int r = rand() % 100;
+        fprintf(out, "gap %d\n", 60 + rand() % 190);
+        if (r < 75 && known) fprintf(out, "keys %04u#\n", crowd[rand() % known]);
+        else if (r < 85) fprintf(out, "keys %04d#\n", 1 + rand() % 9999); // Mostly not in the directory
+        else if (r < 90) fprintf(out, "keys %03d#\n", rand() % 1000);
+        else if (r < 95) fprintf(out, "keys A\n");
+        else fprintf(out, "keys B\n");
+        fprintf(out, "wait %d\n", (rand() % 10 < 7) ? 3000 : 300 + rand() % 900); // Screen times out, or the next person is quick
+    }
+}
+
+static void report(double wallSecs) {
+    printf("%-11s %6s %10s %10s %10s %11s\n", "key", "count", "p50 us", "p90 us", "p99 us", "max us");
+    for (int s = 0; s < 4; s++) {
+        Samples* k = &keyStage[s];
+        printf("%-11s %6lu %10llu %10llu %10llu %11llu\n", stageNames[s], k->n, percentile(k, 50), percentile(k, 90),
+               percentile(k, 99), percentile(k, 100));
+    }
+    unsigned long keys = keyStage[3].n ? keyStage[3].n : 1;
+    printf("per key: %.1f LCD bytes, %.2f RTC transactions, %llu us in delays\n\n", (double)keyLcd / keys,
+           (double)keyRtc / keys, keyDelayUs / keys);
+
+    printf("%-11s %6s %10s %10s %10s %11s %11s %9s %7s %9s\n", "transaction", "count", "p50 us", "p99 us", "max us",
+           "result p50", "result p99", "LCD B/tx", "RTC/tx", "delay/tx");
+    for (int t = 0; t < TX_KINDS; t++) {
+        Samples* x = &txLatency[t];
+        if (!x->n) continue;
+        printf("%-11s %6lu %10llu %10llu %10llu %11llu %11llu %9.1f %7.2f %9llu\n", kindNames[t], x->n, percentile(x, 50),
+               percentile(x, 99), percentile(x, 100), percentile(&txResult[t], 50), percentile(&txResult[t], 99),
+               (double)txLcd[t] / x->n, (double)txRtc[t] / x->n, txDelayUs[t] / x->n);
+    }
+    unsigned long badges = txLatency[TX_ENTRY].n + txLatency[TX_EXIT].n;
+    if (badges > 1) {
+        double secs = (badgeLastUs - badgeFirstUs) / 1e6;
+        printf("door: %lu entries and exits in %.1f s, %.1f per minute\n", badges, secs, badges * 60 / secs);
+    }
+    printf("golden: %lu checks, %lu mismatches\n", goldenChecks, goldenFailures);
+    printf("virtual %.1f s in %.3f s of host time\n", simNowUs() / 1e6, wallSecs);
+}
+
+int main(int argc, char** argv) {
+    const char* dirFile = NULL;
+    const char* traceFile = NULL;
+    const char* recordFile = NULL;
+    unsigned long generateCount = 0, seed = 2301;
+    unsigned long long budgetUs = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-x") && i + 1 < argc) dirFile = argv[++i];
+        else if (!strcmp(argv[i], "--budget") && i + 1 < argc) budgetUs = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc) recordFile = argv[++i];
+        else if (!strcmp(argv[i], "--generate") && i + 1 < argc) generateCount = strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = strtoul(argv[++i], NULL, 10);
+        else if (argv[i][0] != '-' && !traceFile) traceFile = argv[i];
+        else traceFile = NULL, generateCount = 0, i = argc; // Fall through to usage
+    }
+    if (!traceFile == !generateCount) {
+        fprintf(stderr, "usage: %s [-x directory.bin] [--budget US] [--record OUT] TRACE\n"
+                        "       %s [-x directory.bin] [--budget US] [--record OUT] --generate N [--seed S]\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    if (dirFile) {
+        FILE* f = fopen(dirFile, "rb");
+        if (!f) { perror(dirFile); return 2; }
+        size_t n = fread(simExtEeprom(), 1, DIR_DEVICE_SIZE, f);
+        fclose(f);
+        if (n < DIR_HEADER_SIZE) { fprintf(stderr, "%s: not a directory image\n", dirFile); return 2; }
+    }
+    FILE* trace = traceFile ? fopen(traceFile, "r") : tmpfile();
+    if (!trace) { perror(traceFile ? traceFile : "tmpfile"); return 2; }
+    if (generateCount) {
+        generate(trace, generateCount, seed);
+        rewind(trace);
+    }
+    if (recordFile) {
+        recordOut = fopen(recordFile, "w");
+        if (!recordOut) { perror(recordFile); return 2; }
+        fprintf(recordOut, "# Recorded by bench_keys%s\n", generateCount ? " --generate" : "");
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int ok = replay(trace);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    fclose(trace);
+    if (recordOut) fclose(recordOut);
+    if (!ok) return 2;
+
+    report((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    unsigned long long p99 = percentile(&txAll, 99);
+    if (budgetUs && p99 > budgetUs) {
+        printf("over budget: result p99 %llu us > %llu us\n", p99, budgetUs);
+        return 1;
+    }
+    return goldenFailures ? 1 : 0;
+}
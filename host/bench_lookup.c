@@ -0,0 +1,58 @@
+// Directory lookup benchmark: the firmware's searchIds() binary search against a
+// linear scan of the same sorted table, over synthetic directories of growing size.
+// Host numbers only show the shape of the curve; on the PIC every probe is a
+// RETLW table read, so the gap is wider there.
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+int searchIds(const unsigned int* ids, unsigned int count, unsigned int id);
+
+static int linearIds(const unsigned int* ids, unsigned int count, unsigned int id) {
+    for (unsigned int i = 0; i < count; i++) {
+        if (ids[i] == id) return (int)i;
+    }
+    return -1;
+}
+
+static double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#define QUERIES 4096
+
+int main(int argc, char** argv) {
+    unsigned long rounds = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200;
+    static const unsigned int sizes[] = { 10, 32, 100, 300, 1000, 4000 };
+    unsigned int queries[QUERIES];
+    long binarySum = 0, linearSum = 0; // Printed at the end, so the loops cannot be optimised away
+
+    printf("%8s %14s %14s %8s\n", "users", "binary ns/op", "linear ns/op", "speedup");
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        unsigned int count = sizes[s];
+        unsigned int* ids = malloc(count * sizeof(unsigned int));
+        unsigned int id = 2301;
+        for (unsigned int i = 0; i < count; i++) { ids[i] = id; id += 1 + (unsigned int)(rand() % 3); }
+        // Three hits for every miss, like a door where most codes are valid
+        for (unsigned int q = 0; q < QUERIES; q++) {
+            queries[q] = (q % 4) ? ids[rand() % count] : 2301 + (unsigned int)(rand() % (id - 2301 + 100));
+        }
+
+        double t0 = nowNs();
+        for (unsigned long r = 0; r < rounds; r++)
+            for (unsigned int q = 0; q < QUERIES; q++) binarySum += searchIds(ids, count, queries[q]);
+        double t1 = nowNs();
+        for (unsigned long r = 0; r < rounds; r++)
+            for (unsigned int q = 0; q < QUERIES; q++) linearSum += linearIds(ids, count, queries[q]);
+        double t2 = nowNs();
+
+        double ops = (double)rounds * QUERIES;
+        double binary = (t1 - t0) / ops, linear = (t2 - t1) / ops;
+        printf("%8u %14.2f %14.2f %7.1fx\n", count, binary, linear, linear / binary);
+        free(ids);
+    }
+    printf("index sums: binary %ld, linear %ld\n", binarySum, linearSum); // Equal when both searches agree
+    return 0;
+}
@@ -0,0 +1,464 @@
+// Linux host implementation of hal.h for the simulator.
+// Nothing here sleeps: virtual time only moves when the firmware delays, talks
+// to a peripheral, or the simulator lets it pass, and interrupts are delivered
+// at those points with the same masking rules as the PIC.
+#include <stdio.h>
+#include <string.h>
+#include "hal_host.h"
+
+#define TICK_US 1000ULL          // Timer0 period
+#define CLOCK_US 100000ULL       // CCP1 special event period
+#define EE_WRITE_US 4000ULL      // Data EEPROM byte write time
+#define LCD_EXEC_US 40ULL        // Most HD44780 instructions and data writes
+#define LCD_SLOW_US 1640ULL      // Clear display / return home
+#define UART_BYTE_US 88ULL       // 10 bits at 113636 baud (SPBRG = 10, BRGH = 1)
+#define I2C_BYTE_NS 21600ULL     // 9 bits at 417 kHz (SSPADD = 11)
+#define I2C_FRAME_NS 7200ULL     // Start, restart and stop conditions
+#define EXT_EE_WRITE_US 5000ULL  // 24LC256 page write cycle
+#define EXT_EE_POLLS 250ULL      // Control bytes hal_pic16.c sends before giving up on a chip
+#define OSC_START_US 51ULL       // Oscillator start-up timer on wake: 1024 cycles at 20 MHz
+
+static unsigned long long nowUs = 0;
+static SimHalCounters counters;
+
+// --- Interrupt state ---
+static unsigned char started = 0; // HAL_StartInterrupts() ran
+static unsigned char gie = 0, tickIe = 0, clockIe = 0, eeIe = 0, txIe = 0, rcIe = 0;
+static unsigned char tickIf = 0, clockIf = 0, eeIf = 0, txIf = 1, rcIf = 0;
+static unsigned char inIsr = 0;
+static unsigned long long nextTickUs = 0, nextClockUs = 0;
+
+// --- Sleep ---
+static unsigned char asleep = 0;
+static unsigned long long sleptUs = 0, wakeUs = 0; // When the current sleep began / will end (0 = no key yet)
+static unsigned long long tickLeftUs = 0, clockLeftUs = 0; // Timer0 and Timer1 hold their counts
+static unsigned long sleeps = 0, rxLostAsleep = 0;
+static unsigned long long asleepUs = 0;
+
+// --- Peripherals ---
+static unsigned char keyRow = 0;       // Row the firmware drives low
+static unsigned char heldRow = 0xFF;   // Key held down, 0xFF = none
+static unsigned char heldCol = 0;
+
+static char ddram[0x68];               // HD44780 display RAM (2-line mode: 0x00-0x27, 0x40-0x67)
+static unsigned char lcdAddr = 0;
+static unsigned char lcdToCgram = 0;   // Data writes go to CGRAM (ignored)
+static unsigned long long lcdBusyUntil = 0;
+
+static unsigned long rtcBase = 0;      // Wall clock at rtcBaseUs
+static unsigned long long rtcBaseUs = 0;
+static unsigned char rtcWp = 0x80;     // Write protect register
+
+static unsigned char eeprom[256];
+static unsigned char eeInit = 0;
+static unsigned char eeBusy = 0;
+static unsigned long long eeDoneUs = 0;
+static unsigned char eeAddr = 0, eeData = 0;
+
+static unsigned char extEe[65536];     // Two 24LC256: directory (A0 low), then daily totals (A0 high)
+static unsigned char extEeInit = 0;
+static unsigned long extEeReads = 0, extEeBytes = 0, extEeWrites = 0;
+static unsigned long long extEeBusyUntil = 0; // End of the last page write cycle
+static unsigned char extEeMissing[2] = { 0, 0 }; // Chip not fitted: directory, totals
+static unsigned long long i2cNs = 0;   // Bus time not yet passed on to simAdvance (sub-microsecond)
+
+static unsigned long long txDoneUs = 0;  // When the byte in TXREG has gone out
+static void (*txSink)(unsigned char) = NULL;
+static unsigned char rxQueue[4096];      // Bytes still to arrive, one every UART_BYTE_US
+static unsigned int rxHead = 0, rxTail = 0;
+static unsigned long long rxNextUs = 0;
+static unsigned char rcReg = 0;
+
+// Run every pending, enabled interrupt (like the PIC, one ISR pass handles them all)
+static void dispatch() {
+    if (inIsr || !gie) return;
+    inIsr = 1;
+    while ((tickIf && tickIe) || (clockIf && clockIe) || (eeIf && eeIe) || (txIf && txIe) || (rcIf && rcIe)) {
+        if (tickIf && tickIe) { tickIf = 0; HAL_OnTick(); }
+        if (clockIf && clockIe) { clockIf = 0; HAL_OnClockTick(); }
+        if (eeIf && eeIe) { eeIf = 0; HAL_OnEeDone(); }
+        if (rcIf && rcIe) { rcIf = 0; HAL_OnUartRx(rcReg); }
+        if (txIf && txIe) HAL_OnUartTx(); // TXIF only clears when TXREG is loaded
+    }
+    inIsr = 0;
+}
+
+unsigned long long simNowUs() { return nowUs; }
+
+// Restart the oscillator: the timers carry on from where they stopped
+static void wake() {
+    asleep = 0;
+    asleepUs += nowUs - sleptUs;
+    nextTickUs = nowUs + tickLeftUs;
+    nextClockUs = nowUs + clockLeftUs;
+}
+
+void simAdvance(unsigned long long us) {
+    unsigned long long target = nowUs + us;
+    unsigned char wasAsleep = asleep;
+    while (1) {
+        unsigned long long next = target;
+        if (started && !asleep && nextTickUs < next) next = nextTickUs;
+        if (started && !asleep && nextClockUs < next) next = nextClockUs;
+        if (asleep && wakeUs && wakeUs < next) next = wakeUs;
+        if (eeBusy && eeDoneUs < next) next = eeDoneUs;
+        if (!txIf && txDoneUs < next) next = txDoneUs;
+        if (rxHead != rxTail && rxNextUs < next) next = rxNextUs;
+        nowUs = next;
+        if (asleep && wakeUs && nowUs >= wakeUs) wake();
+        if (started && !asleep && nowUs >= nextTickUs) { tickIf = 1; nextTickUs += TICK_US; }
+        if (started && !asleep && nowUs >= nextClockUs) { clockIf = 1; nextClockUs += CLOCK_US; }
+        if (eeBusy && nowUs >= eeDoneUs) {
+            eeprom[eeAddr] = eeData;
+            eeBusy = 0;
+            eeIf = 1;
+        }
+        if (!txIf && nowUs >= txDoneUs) txIf = 1;
+        if (rxHead != rxTail && nowUs >= rxNextUs) { // Next byte lands in RCREG (an unread one is overrun)
+            rcReg = rxQueue[rxTail];
+            rxTail = (rxTail + 1) % sizeof(rxQueue);
+            if (asleep) rxLostAsleep++; // No clock for the receiver
+            else rcIf = 1;
+            rxNextUs = nowUs + UART_BYTE_US;
+        }
+        dispatch();
+        if (nowUs >= target || (wasAsleep && !asleep)) break;
+    }
+}
+
+// ------------------ Board Setup ------------------
+static void eepromInit() {
+    if (eeInit) return;
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    eeInit = 1;
+}
+
+void HAL_Init() {
+    keyRow = 0;
+    memset(ddram, ' ', sizeof(ddram));
+    lcdAddr = 0;
+    eepromInit();
+}
+
+void HAL_StartInterrupts() {
+    started = 1;
+    nextTickUs = nowUs + TICK_US;
+    nextClockUs = nowUs + CLOCK_US;
+    tickIe = clockIe = eeIe = rcIe = 1;
+    gie = 1;
+    dispatch();
+}
+
+// ------------------ Interrupt Masking ------------------
+unsigned char HAL_IrqDisable() {
+    unsigned char was = gie;
+    gie = 0;
+    return was;
+}
+void HAL_IrqRestore(unsigned char on) { gie = on; dispatch(); }
+void HAL_TickIrq(unsigned char on) { tickIe = on; dispatch(); }
+void HAL_ClockIrq(unsigned char on) { clockIe = on; dispatch(); }
+void HAL_ClockRestart() { nextClockUs = nowUs + CLOCK_US; }
+
+// ------------------ Keypad ------------------
+void HAL_KeypadSelectRow(unsigned char row) { keyRow = row; }
+unsigned char HAL_KeypadColumns() {
+    if (heldRow != keyRow) return 0x0F;
+    return 0x0F & (unsigned char)~(1 << heldCol);
+}
+
+extern const char keyValues[4][4]; // Keypad layout, from the firmware
+
+unsigned char simKeyDown(char key) {
+    for (unsigned char r = 0; r < 4; r++) {
+        for (unsigned char c = 0; c < 4; c++) {
+            if (keyValues[r][c] != key) continue;
+            heldRow = r; heldCol = c;
+            if (asleep && !wakeUs) wakeUs = nowUs + OSC_START_US; // Interrupt-on-change, all rows low
+            return 1;
+        }
+    }
+    return 0;
+}
+void simKeyUp() { heldRow = 0xFF; }
+
+// ------------------ Sleep ------------------
+// The PIC blocks in HAL_Sleep() until the wake-up. Here the call returns at once and
+// the core counts as halted: the simulator stops running the main loop, the timers
+// stop, and simAdvance() returns early when a key press wakes it.
+void HAL_Sleep() {
+    if (heldRow != 0xFF) return; // A column is already low: SLEEP would be a NOP
+    asleep = 1;
+    sleeps++;
+    sleptUs = nowUs;
+    wakeUs = 0;
+    tickLeftUs = nextTickUs - nowUs;
+    clockLeftUs = nextClockUs - nowUs;
+}
+
+unsigned char simAsleep() { return asleep; }
+void simSleepStats(unsigned long* count, unsigned long long* us, unsigned long* rxLost) {
+    *count = sleeps;
+    *us = asleepUs + (asleep ? nowUs - sleptUs : 0);
+    *rxLost = rxLostAsleep;
+}
+
+// ------------------ LCD ------------------
+// Decode the instructions the firmware uses into DDRAM contents
+void HAL_LcdWrite(unsigned char rs, unsigned char value) {
+    simAdvance(1);
+    counters.lcdWrites++;
+    unsigned long long busy = LCD_EXEC_US;
+    if (rs) {
+        if (!lcdToCgram) {
+            ddram[lcdAddr] = (char)value;
+            lcdAddr++;
+            if (lcdAddr == 0x28) lcdAddr = 0x40;
+            else if (lcdAddr == 0x68) lcdAddr = 0x00;
+        }
+    } else if (value & 0x80) { // Set DDRAM address
+        lcdAddr = value & 0x7F;
+        if (lcdAddr >= 0x68 || (lcdAddr >= 0x28 && lcdAddr < 0x40)) lcdAddr = 0;
+        lcdToCgram = 0;
+    } else if (value & 0x40) { // Set CGRAM address
+        lcdToCgram = 1;
+    } else if (value == 0x01) { // Clear display
+        memset(ddram, ' ', sizeof(ddram));
+        lcdAddr = 0;
+        lcdToCgram = 0;
+        busy = LCD_SLOW_US;
+    } else if ((value & 0xFE) == 0x02) { // Return home
+        lcdAddr = 0;
+        busy = LCD_SLOW_US;
+    } // Entry mode, display control and function set change nothing visible here
+    lcdBusyUntil = nowUs + busy;
+}
+unsigned char HAL_LcdBusy() {
+    simAdvance(2);
+    counters.lcdBusyPolls++;
+    return nowUs < lcdBusyUntil;
+}
+
+void simLcdLine(unsigned char row, char* out) {
+    memcpy(out, &ddram[row ? 0x40 : 0x00], 16);
+    out[16] = '\0';
+}
+
+// ------------------ DS1302 ------------------
+static const unsigned char monthDays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+typedef struct {
+    unsigned int year; // 2000-2099
+    unsigned char month, date, hour, min, sec, day;
+} Calendar;
+
+static unsigned char leap(unsigned int year) { return (year % 4) == 0; } // Exact for 2000-2099
+static unsigned char daysIn(unsigned int year, unsigned char month) {
+    return (month == 2 && leap(year)) ? 29 : monthDays[month - 1];
+}
+
+static void toCalendar(unsigned long secs, Calendar* c) {
+    unsigned long days = secs / 86400UL;
+    unsigned long rem = secs % 86400UL;
+    c->hour = (unsigned char)(rem / 3600); c->min = (unsigned char)((rem / 60) % 60); c->sec = (unsigned char)(rem % 60);
+    c->day = (unsigned char)((days + 6) % 7 + 1); // 2000-01-01 was a Saturday (day 7, Sunday = 1)
+    c->year = 2000;
+    while (days >= (leap(c->year) ? 366UL : 365UL)) { days -= leap(c->year) ? 366UL : 365UL; c->year++; }
+    c->month = 1;
+    while (days >= daysIn(c->year, c->month)) { days -= daysIn(c->year, c->month); c->month++; }
+    c->date = (unsigned char)(days + 1);
+}
+
+static unsigned long fromCalendar(const Calendar* c) {
+    unsigned long days = 0;
+    for (unsigned int y = 2000; y < c->year; y++) days += leap(y) ? 366 : 365;
+    for (unsigned char m = 1; m < c->month; m++) days += daysIn(c->year, m);
+    days += c->date - 1;
+    return days * 86400UL + c->hour * 3600UL + c->min * 60UL + c->sec;
+}
+
+static unsigned char toBcd(unsigned char v) { return (unsigned char)(((v / 10) << 4) | (v % 10)); }
+static unsigned char fromBcd(unsigned char v) { return (unsigned char)((v >> 4) * 10 + (v & 0x0F)); }
+
+unsigned long simRtcNow() { return rtcBase + (unsigned long)((nowUs - rtcBaseUs) / 1000000ULL); }
+void simRtcSet(unsigned long secs) { rtcBase = secs; rtcBaseUs = nowUs; }
+
+unsigned char simRtcParse(const char* text, unsigned long* secs) {
+    unsigned int y, mo, d, h, mi, s;
+    if (sscanf(text, "%u-%u-%u %u:%u:%u", &y, &mo, &d, &h, &mi, &s) != 6) return 0;
+    if (y < 2000 || y > 2099 || mo < 1 || mo > 12 || h > 23 || mi > 59 || s > 59) return 0;
+    if (d < 1 || d > daysIn(y, (unsigned char)mo)) return 0;
+    Calendar c = { y, (unsigned char)mo, (unsigned char)d, (unsigned char)h, (unsigned char)mi, (unsigned char)s, 0 };
+    *secs = fromCalendar(&c);
+    return 1;
+}
+
+// Register image in clock burst order: sec, min, hour, date, month, day, year, WP
+static void rtcRegisters(unsigned char* regs) {
+    Calendar c;
+    toCalendar(simRtcNow(), &c);
+    regs[0] = toBcd(c.sec); regs[1] = toBcd(c.min); regs[2] = toBcd(c.hour); // 24 hr mode
+    regs[3] = toBcd(c.date); regs[4] = toBcd(c.month); regs[5] = c.day;
+    regs[6] = toBcd((unsigned char)(c.year - 2000)); regs[7] = rtcWp;
+}
+
+// Bit-banged transaction timing on the PIC: 3 us per written bit, 2 us per read bit, 4 us RST edges
+void HAL_RtcWrite(unsigned char cmd, unsigned char data) {
+    simAdvance(4 + 16 * 3 + 4);
+    counters.rtcTransactions++;
+    unsigned char reg = (cmd >> 1) & 0x1F;
+    if (cmd & 0x40) return; // RAM area is not modelled
+    if (reg == 7) { rtcWp = data & 0x80; return; }
+    if (rtcWp || reg > 6) return;
+    Calendar c;
+    toCalendar(simRtcNow(), &c);
+    switch (reg) {
+        case 0: c.sec = fromBcd(data & 0x7F); break;
+        case 1: c.min = fromBcd(data & 0x7F); break;
+        case 2: c.hour = fromBcd(data & 0x3F); break;
+        case 3: c.date = fromBcd(data & 0x3F); break;
+        case 4: c.month = fromBcd(data & 0x1F); break;
+        case 5: return; // Day of week follows from the date here
+        case 6: c.year = 2000 + fromBcd(data); break;
+    }
+    if (c.month < 1 || c.month > 12) c.month = 1;
+    if (c.date < 1 || c.date > daysIn(c.year, c.month)) c.date = 1;
+    simRtcSet(fromCalendar(&c));
+}
+unsigned char HAL_RtcRead(unsigned char cmd) {
+    unsigned char data;
+    HAL_RtcReadBurst(cmd, &data, 1);
+    return data;
+}
+void HAL_RtcReadBurst(unsigned char cmd, unsigned char* buf, unsigned char len) {
+    simAdvance(4 + 8 * 3 + 1 + (unsigned long long)len * 8 * 2 + 4);
+    counters.rtcTransactions++;
+    unsigned char regs[8];
+    rtcRegisters(regs); // Latched once, like the chip does for a burst
+    unsigned char reg = ((cmd >> 1) & 0x1F) == 0x1F ? 0 : (cmd >> 1) & 0x07;
+    for (unsigned char i = 0; i < len; i++) buf[i] = (cmd & 0x40) ? 0 : regs[(reg + i) & 0x07];
+}
+
+// ------------------ Data EEPROM ------------------
+unsigned char HAL_EeRead(unsigned char addr) {
+    while (eeBusy) simAdvance(1); // Interrupts keep running while the write finishes
+    return eeprom[addr];
+}
+void HAL_EeWrite(unsigned char addr, unsigned char data) {
+    eeAddr = addr;
+    eeData = data;
+    eeBusy = 1;
+    eeDoneUs = nowUs + EE_WRITE_US;
+}
+
+unsigned char* simEeprom() {
+    eepromInit();
+    return eeprom;
+}
+
+// ------------------ 24LC256 ------------------
+static void extEepromInit() {
+    if (extEeInit) return;
+    memset(extEe, 0xFF, sizeof(extEe));
+    extEeInit = 1;
+}
+
+// Bus time for one transaction, after polling out a write cycle still running
+static void i2cTransaction(unsigned long long bytes) {
+    extEepromInit();
+    if (nowUs < extEeBusyUntil) simAdvance(extEeBusyUntil - nowUs);
+    i2cNs += I2C_FRAME_NS + bytes * I2C_BYTE_NS;
+    simAdvance(i2cNs / 1000ULL);
+    i2cNs %= 1000ULL;
+}
+
+// A chip that is not fitted NACKs every control byte until the firmware gives up
+static unsigned char extEeAbsent(unsigned int addr) {
+    if (!extEeMissing[addr >> 15]) return 0;
+    i2cNs += EXT_EE_POLLS * (I2C_FRAME_NS + I2C_BYTE_NS);
+    i2cTransaction(0);
+    return 1;
+}
+
+// Control byte, two address bytes, control byte again, then the data
+unsigned char HAL_ExtEeRead(unsigned int addr, unsigned char* buf, unsigned char len) {
+    if (extEeAbsent(addr)) {
+        memset(buf, 0xFF, len);
+        return 0;
+    }
+    i2cTransaction(4ULL + len);
+    unsigned int chip = addr & 0x8000;
+    for (unsigned char i = 0; i < len; i++) buf[i] = extEe[chip | ((addr + i) & 0x7FFF)]; // Sequential reads wrap in the chip
+    extEeReads++;
+    extEeBytes += len;
+    return 1;
+}
+// Control byte, two address bytes, then the data; the chip is busy for the write cycle after
+unsigned char HAL_ExtEeWrite(unsigned int addr, const unsigned char* buf, unsigned char len) {
+    if (extEeAbsent(addr)) return 0;
+    i2cTransaction(3ULL + len);
+    unsigned int page = addr & 0xFFC0;
+    for (unsigned char i = 0; i < len; i++) extEe[page | ((addr + i) & 0x3F)] = buf[i]; // Page writes wrap in the page
+    extEeWrites++;
+    extEeBusyUntil = nowUs + EXT_EE_WRITE_US;
+    return 1;
+}
+// One control byte: ACKed unless the chip is missing or still in its write cycle
+unsigned char HAL_ExtEeIdle(unsigned int addr) {
+    extEepromInit();
+    i2cNs += I2C_FRAME_NS + I2C_BYTE_NS;
+    simAdvance(i2cNs / 1000ULL);
+    i2cNs %= 1000ULL;
+    return !extEeMissing[addr >> 15] && nowUs >= extEeBusyUntil;
+}
+
+unsigned char* simExtEeprom() {
+    extEepromInit();
+    return extEe;
+}
+void simExtEeFitted(unsigned char chip, unsigned char fitted) { extEeMissing[chip & 1] = !fitted; }
+unsigned char simExtEeCommand(const char* text) {
+    char chip[16], state[4];
+    if (sscanf(text, "%15s %3s", chip, state) != 2) return 0;
+    if (strcmp(chip, "directory") && strcmp(chip, "totals")) return 0;
+    if (strcmp(state, "on") && strcmp(state, "off")) return 0;
+    simExtEeFitted(chip[0] == 't', state[1] == 'n');
+    return 1;
+}
+void simExtEeStats(unsigned long* reads, unsigned long* bytes, unsigned long* writes) {
+    *reads = extEeReads;
+    *bytes = extEeBytes;
+    *writes = extEeWrites;
+}
+
+// ------------------ USART ------------------
+// One byte on the wire at a time; TXIF comes back when it has been shifted out
+void HAL_UartTxIrq(unsigned char on) { txIe = on; dispatch(); }
+void HAL_UartTxByte(unsigned char data) {
+    if (txSink) txSink(data);
+    txIf = 0;
+    txDoneUs = nowUs + UART_BYTE_US;
+}
+
+void simUartSink(void (*sink)(unsigned char)) { txSink = sink; }
+void simUartRx(const unsigned char* data, unsigned int len) {
+    if (rxHead == rxTail && rxNextUs < nowUs) rxNextUs = nowUs + UART_BYTE_US;
+    for (unsigned int i = 0; i < len; i++) {
+        unsigned int next = (rxHead + 1) % sizeof(rxQueue);
+        if (next == rxTail) break; // Host side buffer full
+        rxQueue[rxHead] = data[i];
+        rxHead = next;
+    }
+}
+
+// ------------------ Delays ------------------
+void delay_ms(unsigned int ms) {
+    counters.delayUs += (unsigned long long)ms * 1000ULL;
+    simAdvance((unsigned long long)ms * 1000ULL);
+}
+void delay_us(unsigned int us) {
+    counters.delayUs += us;
+    simAdvance(us);
+}
+
+void simHalCounters(SimHalCounters* out) { *out = counters; }
@@ -0,0 +1,51 @@
+// Linux host implementation of hal.h: simulator controls.
+// Time is virtual - delays and bus transactions advance it instead of sleeping,
+// and the 1 ms / 100 ms / EEPROM interrupts fire as it passes.
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include "hal.h"
+
+// --- Virtual time ---
+unsigned long long simNowUs();
+void simAdvance(unsigned long long us); // Let time pass, delivering due interrupts
+
+// --- Keypad: one key held at a time ---
+unsigned char simKeyDown(char key); // Returns 0 for a key the keypad does not have
+void simKeyUp();
+
+// --- Sleep: while the core sleeps the main loop must not run (see HAL_Sleep) ---
+unsigned char simAsleep();
+void simSleepStats(unsigned long* count, unsigned long long* us, unsigned long* rxLost); // Sleeps, time asleep, USART bytes missed
+
+// --- LCD: visible 16 characters of a line (17 bytes with the terminator) ---
+void simLcdLine(unsigned char row, char* out);
+
+// --- DS1302: wall clock as seconds since 2000-01-01 00:00:00 ---
+void simRtcSet(unsigned long secs);
+unsigned long simRtcNow();
+unsigned char simRtcParse(const char* text, unsigned long* secs); // "YYYY-MM-DD HH:MM:SS"
+
+// --- USART: every transmitted byte is handed to sink as it leaves ---
+void simUartSink(void (*sink)(unsigned char));
+void simUartRx(const unsigned char* data, unsigned int len); // Queue bytes to arrive at line rate
+
+// --- Data EEPROM (256 bytes, erased to 0xFF) ---
+unsigned char* simEeprom();
+
+// --- External EEPROMs (two 24LC256, 64 KB, erased to 0xFF): directory image first, daily totals at 0x8000 ---
+unsigned char* simExtEeprom();
+void simExtEeFitted(unsigned char chip, unsigned char fitted); // 0 = directory, 1 = totals; a missing chip never answers
+unsigned char simExtEeCommand(const char* text); // "directory|totals on|off"; returns 0 if not understood
+void simExtEeStats(unsigned long* reads, unsigned long* bytes, unsigned long* writes); // Transactions and data bytes so far
+
+// --- HAL call counters since start-up, for the benches ---
+typedef struct {
+    unsigned long lcdWrites;       // Instruction and data bytes sent to the LCD
+    unsigned long lcdBusyPolls;    // Busy-flag reads while waiting on the LCD
+    unsigned long rtcTransactions; // DS1302 reads, bursts and writes
+    unsigned long long delayUs;    // Time spent in delay_ms() / delay_us()
+} SimHalCounters;
+void simHalCounters(SimHalCounters* out);
+
+#endif
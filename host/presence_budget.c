@@ -0,0 +1,108 @@
+// Presence budget report: RAM, data EEPROM and lookup cycles of the presence table for
+// a range of MAX_PRESENT_USERS settings, from the sizing macros in presence.h.
+//
+//   presence_budget [N...]
+//
+// For each size it prints the two RAM groups against their bank, the snapshot against
+// the data EEPROM, and what stops the build if anything does (the same checks
+// attendence.c makes). Lookup cost is measured by filling the hash with N random roll
+// numbers from a 900-user roster starting at 2301, using the firmware's PRESENCE_HOME,
+// and counting probes for present and absent users. Probes are turned into PIC16
+// cycles with the CY_ figures below; CY_BANK_SWITCH is what every probe would add if
+// the roll numbers and the hash sat in different banks.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "presence.h"
+
+#define PIC_RAM_BYTES 368         // 16F877A general purpose RAM, all banks
+#define ROSTER_FIRST 2301
+#define ROSTER_SIZE 900
+#define TRIALS 2000
+
+#define CY_LOOKUP 24              // Call, PRESENCE_HOME and the return
+#define CY_PROBE 23               // Read a cell, test it, compare the 16-bit roll number, wrap
+#define CY_BANK_SWITCH 4          // RP0/RP1 set and restore around the roll-number read
+
+typedef struct {
+    double hit, miss;             // Average probes
+    unsigned int hitMax, missMax;
+} Probes;
+
+// Probes for every present roll number and for absent ones, averaged over TRIALS fills
+static Probes measure(unsigned int n) {
+    unsigned int size = PRESENCE_HASH_FOR(n);
+    unsigned int* ids = malloc(n * sizeof(unsigned int));
+    unsigned char* cells = malloc(size);
+    Probes p = { 0, 0, 0, 0 };
+    unsigned long hits = 0, misses = 0;
+    srand(2301);
+    for (unsigned int t = 0; t < TRIALS; t++) {
+        for (unsigned int c = 0; c < size; c++) cells[c] = 0;
+        unsigned int placed = 0;
+        while (placed < n) { // Distinct roll numbers, linked as addEntryTime() does
+            unsigned int id = ROSTER_FIRST + (unsigned int)(rand() % ROSTER_SIZE), dup = 0;
+            for (unsigned int i = 0; i < placed; i++) dup |= ids[i] == id;
+            if (dup) continue;
+            ids[placed] = id;
+            unsigned int h = PRESENCE_HOME(id, size);
+            while (cells[h]) h = (h + 1) & (size - 1);
+            cells[h] = (unsigned char)(++placed);
+        }
+        for (unsigned int i = 0; i < placed; i++) { // Present: probes up to and including the match
+            unsigned int h = PRESENCE_HOME(ids[i], size), probes = 1;
+            while (ids[cells[h] - 1] != ids[i]) { h = (h + 1) & (size - 1); probes++; }
+            p.hit += probes; hits++;
+            if (probes > p.hitMax) p.hitMax = probes;
+        }
+        for (unsigned int i = 0; i < 16; i++) { // Absent: probes up to and including the free cell
+            unsigned int id = ROSTER_FIRST + ROSTER_SIZE + (unsigned int)(rand() % ROSTER_SIZE);
+            unsigned int h = PRESENCE_HOME(id, size), probes = 1;
+            while (cells[h]) { h = (h + 1) & (size - 1); probes++; }
+            p.miss += probes; misses++;
+            if (probes > p.missMax) p.missMax = probes;
+        }
+    }
+    p.hit /= hits;
+    p.miss /= misses;
+    free(ids);
+    free(cells);
+    return p;
+}
+
+static void report(unsigned int n) {
+    unsigned int hash = PRESENCE_HASH_FOR(n);
+    unsigned int lookup = PRESENCE_LOOKUP_BYTES(n), times = PRESENCE_TIMES_BYTES(n), ee = PRESENCE_EE_BYTES(n);
+    char why[64] = "";
+    if (n < 1 || n >= 255) snprintf(why, sizeof(why), "count");
+    else {
+        if (hash * 2 < n * 3) snprintf(why, sizeof(why), "hash");
+        if (lookup > PRESENCE_BANK_BYTES) snprintf(why + strlen(why), sizeof(why) - strlen(why), "%sbank %d", *why ? ", " : "", PRESENCE_LOOKUP_BANK);
+        if (times > PRESENCE_BANK_BYTES) snprintf(why + strlen(why), sizeof(why) - strlen(why), "%sbank %d", *why ? ", " : "", PRESENCE_TIMES_BANK);
+        if (ee > PRESENCE_EE_FREE) snprintf(why + strlen(why), sizeof(why) - strlen(why), "%sEEPROM", *why ? ", " : "");
+    }
+    printf("%5u %5u %6u/%-3d %6u/%-3d %5u %4u%% %6u/%-3d", n, hash, lookup, PRESENCE_BANK_BYTES, times,
+           PRESENCE_BANK_BYTES, lookup + times, (lookup + times) * 100 / PIC_RAM_BYTES, ee, PRESENCE_EE_FREE);
+    if (hash * 2 < n * 3) printf(" %10s %10s %7s %7s %7s", "-", "-", "-", "-", "-"); // Cannot hold them all
+    else {
+        Probes p = measure(n);
+        printf(" %6.2f/%-3u %6.2f/%-3u %7.0f %7.0f %7.0f", p.hit, p.hitMax, p.miss, p.missMax, CY_LOOKUP + p.hit * CY_PROBE,
+               CY_LOOKUP + p.miss * CY_PROBE, CY_LOOKUP + p.hit * (CY_PROBE + CY_BANK_SWITCH));
+    }
+    printf("  %s\n", *why ? why : "fits");
+}
+
+int main(int argc, char** argv) {
+    static const unsigned int sizes[] = { 4, 8, 10, MAX_PRESENT_USERS, 15, 16, 19, 21, 32, 64, 150 };
+    printf("%5s %5s %10s %10s %5s %5s %10s %10s %10s %7s %7s %7s  %s\n", "slots", "hash", "lookup B", "times B", "RAM",
+           "/368", "EEPROM B", "hit probes", "miss", "hit cy", "miss cy", "split", "build");
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) report((unsigned int)strtoul(argv[i], NULL, 10));
+    } else {
+        for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            if (i && sizes[i] == sizes[i - 1]) continue;
+            report(sizes[i]);
+        }
+    }
+    return 0;
+}
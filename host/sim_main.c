@@ -0,0 +1,331 @@
+// Host simulator for the attendance terminal.
+// Runs the unmodified firmware logic against host/hal_host.c and drives it from a
+// script (a file, or stdin):
+//   rtc YYYY-MM-DD HH:MM:SS   set the DS1302 (before or after boot)
+//   boot                      run appInit() (done automatically by the first key/wait)
+//   keys 2301#                press and release each key in turn
+//   wait MS                   let MS milliseconds of virtual time pass
+//   lcd                       print both LCD lines
+//   logreq SEQ [WINDOW]       host asks for the stored log from SEQ on (FRAME_LOG_REQUEST)
+//   logack SEQ                host acknowledges everything before SEQ (FRAME_LOG_ACK)
+//   totals ROLL               host asks for a user's daily totals (FRAME_TOTALS_REQUEST)
+//   extee CHIP on|off         fit or pull the directory or totals 24LC256
+//   lookup ID...              run directory lookups directly and time them
+//   shift N REGULARS          N lookups where 3 of 4 badges come from REGULARS recurring
+//                             users, the rest from anywhere in the directory (external
+//                             directory builds)
+//   stats                     directory cache hit rate and lookup latency, idle sleep and
+//                             key latency so far
+//   # ...                     comment
+// Options: -t prints the LCD every time it changes, -e FILE loads the data EEPROM and
+// the totals 24LC256 (totals and event log) from FILE (if it exists) and saves them
+// back at the end, so runs can follow each other like power cycles, -u FILE writes
+// everything the USART sends to FILE, and -x FILE loads the external directory EEPROM
+// image (tools/dir_image).
+// Lookup latency is virtual time, i.e. the bus transactions a lookup makes; the
+// CPU time of the search itself is not modelled. Key latency runs from a scripted key
+// going down to the debounced key landing in the firmware's queue, split by whether
+// the core was asleep when it went down.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal_host.h"
+#include "protocol.h"
+#include "directory.h"
+
+void appInit();
+void appPoll();
+unsigned char lookupUser(unsigned int id, const char** name);
+extern unsigned int dirLookups, dirHits;
+extern volatile unsigned char keyHead;
+
+#define POLL_US 20       // Virtual cost of one main loop pass
+#define KEY_HOLD_MS 40   // How long a scripted key stays down, and up before the next one
+
+static unsigned char booted = 0;
+static unsigned char trace = 0;
+static char shown[2][17];
+static FILE* uartOut = NULL;
+
+static void uartByte(unsigned char data) { fputc(data, uartOut); }
+
+// Lookup latency, [0] = answered from the cache, [1] = went to the directory
+static unsigned long timedCount[2];
+static unsigned long long timedSum[2], timedMax[2];
+
+// Key latency, [0] = pressed while awake, [1] = pressed while asleep (wake-up included)
+static unsigned long keyCount[2];
+static unsigned long long keySum[2], keyMax[2];
+static unsigned char keyWaiting = 0;       // A scripted press has not reached the queue yet
+static unsigned char keyWaitHead, keyWaitKind;
+static unsigned long long keyDownUs;
+
+#if USER_DIRECTORY_EXTERNAL
+static unsigned long simRandState = 1;
+
+static unsigned long simRand() { // Fixed-seed LCG so runs are repeatable (shift badges)
+    simRandState = simRandState * 1103515245UL + 12345UL;
+    return (simRandState >> 16) & 0x7FFF;
+}
+#endif
+
+static void printLcd(const char* why) {
+    char line[2][17];
+    simLcdLine(0, line[0]);
+    simLcdLine(1, line[1]);
+    unsigned long long ms = simNowUs() / 1000ULL;
+    printf("%8llu.%03llu %-5s |%s|\n", ms / 1000ULL, ms % 1000ULL, why, line[0]);
+    printf("%8s %-5s |%s|\n", "", "", line[1]);
+}
+
+static void boot() {
+    if (booted) return;
+    appInit();
+    booted = 1;
+    simLcdLine(0, shown[0]);
+    simLcdLine(1, shown[1]);
+    if (trace) printLcd("boot");
+}
+
+// Let ms of virtual time pass with the main loop running
+static void run(unsigned long ms) {
+    boot();
+    unsigned long long until = simNowUs() + ms * 1000ULL;
+    while (simNowUs() < until) {
+        if (simAsleep()) { // Core halted: let time pass until the deadline or a wake-up
+            simAdvance(until - simNowUs());
+            continue;
+        }
+        appPoll();
+        simAdvance(POLL_US);
+        if (keyWaiting && keyHead != keyWaitHead) {
+            unsigned long long us = simNowUs() - keyDownUs;
+            keyCount[keyWaitKind]++;
+            keySum[keyWaitKind] += us;
+            if (us > keyMax[keyWaitKind]) keyMax[keyWaitKind] = us;
+            keyWaiting = 0;
+        }
+        if (!trace) continue;
+        char line[2][17];
+        simLcdLine(0, line[0]);
+        simLcdLine(1, line[1]);
+        if (strcmp(line[0], shown[0]) || strcmp(line[1], shown[1])) {
+            memcpy(shown, line, sizeof(shown));
+            printLcd("lcd");
+        }
+    }
+}
+
+static unsigned char timedLookup(unsigned int id) {
+    const char* name;
+    unsigned int hits = dirHits;
+    unsigned long long start = simNowUs();
+    unsigned char found = lookupUser(id, &name);
+    unsigned long long us = simNowUs() - start;
+    int kind = (dirHits != hits) ? 0 : 1;
+    timedCount[kind]++;
+    timedSum[kind] += us;
+    if (us > timedMax[kind]) timedMax[kind] = us;
+    return found;
+}
+
+static void printStats() {
+    unsigned long reads, bytes, writes;
+    simExtEeStats(&reads, &bytes, &writes);
+    printf("directory: %u lookups, %u cache hits (%.1f%%)\n", dirLookups, dirHits,
+           dirLookups ? 100.0 * dirHits / dirLookups : 0.0);
+    static const char* kinds[2] = { "hit ", "miss" };
+    for (int k = 0; k < 2; k++) {
+        printf("  %s latency: %lu timed, avg %llu us, max %llu us\n", kinds[k], timedCount[k],
+               timedCount[k] ? timedSum[k] / timedCount[k] : 0ULL, timedMax[k]);
+    }
+    printf("  bus: %lu reads, %lu bytes, %lu page writes\n", reads, bytes, writes);
+
+    unsigned long sleeps, rxLost;
+    unsigned long long asleepUs;
+    simSleepStats(&sleeps, &asleepUs, &rxLost);
+    printf("sleep: %lu times, asleep %.1f%% of %llu s, %lu USART bytes missed\n", sleeps,
+           simNowUs() ? 100.0 * asleepUs / simNowUs() : 0.0, simNowUs() / 1000000ULL, rxLost);
+    static const char* states[2] = { "awake ", "asleep" };
+    for (int k = 0; k < 2; k++) {
+        printf("  key pressed %s: %lu, avg %llu us, max %llu us\n", states[k], keyCount[k],
+               keyCount[k] ? keySum[k] / keyCount[k] : 0ULL, keyMax[k]);
+    }
+}
+
+#if USER_DIRECTORY_EXTERNAL
+// ID at a position of the loaded image's index
+static unsigned int imageId(unsigned int index) {
+    const unsigned char* ee = simExtEeprom();
+    unsigned int addr = (ee[DIR_HDR_INDEX] | (ee[DIR_HDR_INDEX + 1] << 8))
+                      + index / DIR_ENTRIES_PER_PAGE * DIR_PAGE_SIZE + index % DIR_ENTRIES_PER_PAGE * DIR_ENTRY_SIZE;
+    return ee[addr] | (ee[addr + 1] << 8);
+}
+#endif
+
+// Send a frame to the terminal's USART
+static void hostFrame(unsigned char type, const unsigned char* payload, unsigned char len) {
+    unsigned char frame[PROTO_OVERHEAD + 255];
+    unsigned int crc = PROTO_CRC_INIT;
+    frame[0] = PROTO_SYNC;
+    frame[1] = type;
+    frame[2] = len;
+    memcpy(&frame[3], payload, len);
+    for (unsigned int i = 1; i < 3u + len; i++) crc = protoCrc16(crc, frame[i]);
+    frame[3 + len] = (unsigned char)crc;
+    frame[4 + len] = (unsigned char)(crc >> 8);
+    simUartRx(frame, PROTO_OVERHEAD + len);
+}
+
+static int command(char* line, unsigned int lineNo) {
+    char* arg = line;
+    while (*arg && *arg != ' ' && *arg != '\t') arg++;
+    if (*arg) *arg++ = '\0';
+    while (*arg == ' ' || *arg == '\t') arg++;
+
+    if (!strcmp(line, "rtc")) {
+        unsigned long secs;
+        if (!simRtcParse(arg, &secs)) { fprintf(stderr, "line %u: bad time '%s'\n", lineNo, arg); return 0; }
+        simRtcSet(secs);
+    } else if (!strcmp(line, "boot")) {
+        boot();
+    } else if (!strcmp(line, "keys")) {
+        boot();
+        for (; *arg && *arg != ' '; arg++) {
+            keyWaitKind = simAsleep();
+            if (!simKeyDown(*arg)) { fprintf(stderr, "line %u: no key '%c'\n", lineNo, *arg); return 0; }
+            keyWaiting = 1;
+            keyWaitHead = keyHead;
+            keyDownUs = simNowUs();
+            run(KEY_HOLD_MS);
+            simKeyUp();
+            run(KEY_HOLD_MS);
+        }
+    } else if (!strcmp(line, "wait")) {
+        run(strtoul(arg, NULL, 10));
+    } else if (!strcmp(line, "logreq") || !strcmp(line, "logack")) {
+        char* end;
+        unsigned long seq = strtoul(arg, &end, 10);
+        unsigned char payload[REQ_PAYLOAD_SIZE];
+        payload[0] = (unsigned char)seq;
+        payload[1] = (unsigned char)(seq >> 8);
+        boot();
+        if (line[3] == 'r') {
+            payload[REQ_WINDOW] = (unsigned char)strtoul(end, NULL, 10);
+            hostFrame(FRAME_LOG_REQUEST, payload, REQ_PAYLOAD_SIZE);
+        } else {
+            hostFrame(FRAME_LOG_ACK, payload, ACK_PAYLOAD_SIZE);
+        }
+    } else if (!strcmp(line, "totals")) {
+        unsigned long roll = strtoul(arg, NULL, 10);
+        unsigned char payload[TREQ_PAYLOAD_SIZE] = { (unsigned char)roll, (unsigned char)(roll >> 8) };
+        boot();
+        hostFrame(FRAME_TOTALS_REQUEST, payload, TREQ_PAYLOAD_SIZE);
+    } else if (!strcmp(line, "extee")) {
+        if (!simExtEeCommand(arg)) { fprintf(stderr, "line %u: bad chip '%s'\n", lineNo, arg); return 0; }
+    } else if (!strcmp(line, "lookup")) {
+        boot();
+        while (*arg) {
+            char* end;
+            unsigned long id = strtoul(arg, &end, 10);
+            if (end == arg) { fprintf(stderr, "line %u: bad ID '%s'\n", lineNo, arg); return 0; }
+            printf("lookup %lu: %s\n", id, timedLookup((unsigned int)id) ? "known" : "unknown");
+            for (arg = end; *arg == ' ' || *arg == '\t'; arg++) ;
+        }
+    } else if (!strcmp(line, "shift")) {
+#if USER_DIRECTORY_EXTERNAL
+        char* end;
+        unsigned long n = strtoul(arg, &end, 10);
+        unsigned long regulars = strtoul(end, NULL, 10);
+        boot();
+        const unsigned char* ee = simExtEeprom();
+        unsigned int count = ee[DIR_HDR_COUNT] | (ee[DIR_HDR_COUNT + 1] << 8);
+        if (ee[DIR_HDR_MAGIC] != 'U' || count == 0 || regulars == 0) {
+            fprintf(stderr, "line %u: shift needs a directory image (-x) and REGULARS > 0\n", lineNo);
+            return 0;
+        }
+        if (regulars > count) regulars = count;
+        for (unsigned long i = 0; i < n; i++) {
+            unsigned int index = (simRand() & 3) ? (unsigned int)(simRand() % regulars * (count / regulars))
+                                                 : (unsigned int)((simRand() << 15 | simRand()) % count);
+            timedLookup(imageId(index));
+        }
+#else
+        fprintf(stderr, "line %u: shift needs the external directory build\n", lineNo);
+        return 0;
+#endif
+    } else if (!strcmp(line, "stats")) {
+        printStats();
+    } else if (!strcmp(line, "lcd")) {
+        boot();
+        printLcd("show");
+    } else {
+        fprintf(stderr, "line %u: unknown command '%s'\n", lineNo, line);
+        return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    const char* eepromFile = NULL;
+    const char* dirFile = NULL;
+    const char* scriptFile = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t")) trace = 1;
+        else if (!strcmp(argv[i], "-e") && i + 1 < argc) eepromFile = argv[++i];
+        else if (!strcmp(argv[i], "-x") && i + 1 < argc) dirFile = argv[++i];
+        else if (!strcmp(argv[i], "-u") && i + 1 < argc) {
+            uartOut = fopen(argv[++i], "wb");
+            if (!uartOut) { perror(argv[i]); return 2; }
+            simUartSink(uartByte);
+        }
+        else if (argv[i][0] != '-' && !scriptFile) scriptFile = argv[i];
+        else { fprintf(stderr, "usage: %s [-t] [-e eeprom.bin] [-u uart.bin] [-x directory.bin] [script]\n", argv[0]); return 2; }
+    }
+
+    if (eepromFile) {
+        FILE* f = fopen(eepromFile, "rb");
+        if (f) {
+            if (fread(simEeprom(), 1, 256, f) != 256) fprintf(stderr, "%s: short EEPROM image\n", eepromFile);
+            if (fread(simExtEeprom() + 0x8000, 1, 0x8000, f) != 0x8000) { // Files from before the log moved have none
+                memset(simExtEeprom() + 0x8000, 0xFF, 0x8000);
+            }
+            fclose(f);
+        }
+    }
+
+    if (dirFile) {
+        FILE* f = fopen(dirFile, "rb");
+        if (!f) { perror(dirFile); return 2; }
+        size_t n = fread(simExtEeprom(), 1, DIR_DEVICE_SIZE, f);
+        fclose(f);
+        if (n < DIR_HEADER_SIZE) { fprintf(stderr, "%s: not a directory image\n", dirFile); return 2; }
+    }
+
+    FILE* script = scriptFile ? fopen(scriptFile, "r") : stdin;
+    if (!script) { perror(scriptFile); return 2; }
+    char line[256];
+    unsigned int lineNo = 0;
+    int ok = 1;
+    while (ok && fgets(line, sizeof(line), script)) {
+        lineNo++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char* text = line;
+        while (*text == ' ' || *text == '\t') text++;
+        if (*text == '\0' || *text == '#') continue;
+        ok = command(text, lineNo);
+    }
+    if (script != stdin) fclose(script);
+
+    if (ok && eepromFile) {
+        run(100); // Let queued EEPROM writes land before "power off"
+        FILE* f = fopen(eepromFile, "wb");
+        if (!f || fwrite(simEeprom(), 1, 256, f) != 256 || fwrite(simExtEeprom() + 0x8000, 1, 0x8000, f) != 0x8000) {
+            perror(eepromFile);
+            ok = 0;
+        }
+        if (f) fclose(f);
+    }
+    if (uartOut) fclose(uartOut);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+// Check of the checked-in users_table.h itself, not of what gen_users meant to write:
+// a hand edit or a bad merge shows up here even though the firmware still compiles.
+//   IDs strictly ascending (no duplicates, and the binary search holds)
+//   USER_LOOKUP_PROBES probes enough for USER_COUNT
+//   USER_COUNT names in the pool, filling USER_NAME_POOL_SIZE exactly
+//   userNameBlockAt[b] is where the name of user b * USER_NAME_BLOCK starts
+// Exits non-zero on the first table that fails.
+#include <stdio.h>
+
+#define USER_TABLE_MAX_WORDS 4096 // As in attendence.c; the firmware build checks the real limit
+#include "users_table.h"
+
+int main(void) {
+    int failures = 0;
+
+    for (unsigned int i = 1; i < USER_COUNT; i++) {
+        if (userIds[i - 1] >= userIds[i]) {
+            printf("userIds: %u at %u is not above %u\n", userIds[i], i, userIds[i - 1]);
+            failures++;
+        }
+    }
+
+    unsigned int probes = 0;
+    while ((1UL << probes) <= USER_COUNT) probes++; // A search of n sorted IDs takes floor(log2 n) + 1
+    if (probes > USER_LOOKUP_PROBES) {
+        printf("USER_LOOKUP_PROBES: %u, %u users need %u\n", USER_LOOKUP_PROBES, USER_COUNT, probes);
+        failures++;
+    }
+
+    unsigned int at = 0;
+    for (unsigned int i = 0; i < USER_COUNT; i++) {
+        if (at >= USER_NAME_POOL_SIZE) {
+            printf("userNames: ends after %u of %u names\n", i, USER_COUNT);
+            failures++;
+            break;
+        }
+        if (i % USER_NAME_BLOCK == 0 && userNameBlockAt[i / USER_NAME_BLOCK] != at) {
+            printf("userNameBlockAt[%u]: %u, user %u's name starts at %u\n", i / USER_NAME_BLOCK,
+                   userNameBlockAt[i / USER_NAME_BLOCK], i, at);
+            failures++;
+        }
+        while (at < USER_NAME_POOL_SIZE && userNames[at]) at++;
+        at++; // Terminator
+    }
+    if (at != USER_NAME_POOL_SIZE) {
+        printf("userNames: %u names take %u bytes, USER_NAME_POOL_SIZE is %u\n", USER_COUNT, at, USER_NAME_POOL_SIZE);
+        failures++;
+    }
+
+    printf("users_table.h: %u users, %s\n", USER_COUNT, failures ? "FAIL" : "ok");
+    return failures ? 1 : 0;
+}
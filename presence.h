@@ -0,0 +1,45 @@
+// Presence table sizing. Shared by the firmware and host/presence_budget.
+//
+// MAX_PRESENT_USERS (people inside at once) is the one setting; build with
+// -DMAX_PRESENT_USERS=n to change it. The hash table, the RAM groups and the data
+// EEPROM snapshot below all follow from it, and static checks in attendence.c stop
+// the build when a size no longer fits.
+//
+// RAM on the PIC16F877A is four banks and no object may span two, so the table is
+// kept as two groups placed by access pattern:
+//   PRESENCE_LOOKUP_BANK  roll numbers + roll -> slot hash   every lookup's probe loop
+//                                                             reads both, so it never
+//                                                             switches banks
+//   PRESENCE_TIMES_BANK   entry times + snapshot sequences   touched once per entry,
+//                                                             exit or list line
+// Each group has to fit in its bank's PRESENCE_BANK_BYTES. The data EEPROM keeps two
+// SNAP_RECORD_SIZE copies of every slot.
+// An occupant costs 2 + 4 + 1 bytes of RAM plus 1.5-3 hash cells, and 16 bytes of
+// data EEPROM, which is what caps the 16F877A at 15 (the default).
+#ifndef PRESENCE_H
+#define PRESENCE_H
+
+#ifndef MAX_PRESENT_USERS
+#define MAX_PRESENT_USERS 15
+#endif
+
+#define PRESENCE_LOOKUP_BANK 2
+#define PRESENCE_TIMES_BANK 3
+#define PRESENCE_BANK_BYTES 96    // General purpose RAM in banks 2 and 3 (0x110-0x16F, 0x190-0x1EF)
+#define SNAP_RECORD_SIZE 8        // Two copies per presence slot
+#define PRESENCE_EE_FREE 255      // Data EEPROM below the epoch byte (the event log is on the totals 24LC256)
+
+// Hash cells for n slots: the smallest power of two with at least 1.5 cells per slot.
+// Cell numbers are bytes with PRESENCE_HASH_SIZE meaning "not found", so 128 at most.
+#define PRESENCE_HASH_FOR(n) ((n) * 3 <= 16 ? 8 : (n) * 3 <= 32 ? 16 : (n) * 3 <= 64 ? 32 \
+                              : (n) * 3 <= 128 ? 64 : 128)
+#define PRESENCE_HASH_SIZE PRESENCE_HASH_FOR(MAX_PRESENT_USERS)
+// Where a roll number's probe sequence starts
+#define PRESENCE_HOME(id, size) ((unsigned char)((id) ^ ((id) >> 4)) & ((size) - 1))
+
+// Bytes each group takes for n slots
+#define PRESENCE_LOOKUP_BYTES(n) ((n) * 2 + PRESENCE_HASH_FOR(n))
+#define PRESENCE_TIMES_BYTES(n) ((n) * 4 + (n))
+#define PRESENCE_EE_BYTES(n) ((n) * 2 * SNAP_RECORD_SIZE)
+
+#endif
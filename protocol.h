@@ -0,0 +1,101 @@
+// Serial link between a terminal and the central system (USART, 115200 8N1).
+// Shared by the firmware and the host tools.
+//
+// Frame: [PROTO_SYNC][type][len][payload: len bytes][CRC-16 lo][CRC-16 hi]
+// The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over type, len and the
+// payload. There is no byte stuffing: a receiver that loses its place skips to the
+// next PROTO_SYNC and keeps the first frame whose CRC checks out.
+// Multi-byte fields are little-endian, like the EEPROM records.
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#define PROTO_SYNC 0x7E
+#define PROTO_OVERHEAD 5          // Sync, type, len and the two CRC bytes
+#define PROTO_CRC_INIT 0xFFFF
+
+// --- Frame types ---
+#define FRAME_EVENT 0x01          // Terminal -> host: one entry or exit, sent as it happens
+#define FRAME_CHECKOUT 0x02       // Terminal -> host: exits of an end-of-day checkout, several to a frame
+#define FRAME_LOG_REQUEST 0x10    // Host -> terminal: send the stored log from a sequence number on
+#define FRAME_LOG_DATA 0x11       // Terminal -> host: a batch of stored records
+#define FRAME_LOG_ACK 0x12        // Host -> terminal: every record before a sequence number arrived
+#define FRAME_LOG_END 0x13        // Terminal -> host: nothing more is stored
+#define FRAME_TOTALS_REQUEST 0x20 // Host -> terminal: one user's daily totals
+#define FRAME_TOTALS 0x21         // Terminal -> host: the answer
+
+// Log download: the host asks for records from a start sequence number and the
+// terminal sends FRAME_LOG_DATA frames in sequence order, staying at most 'window'
+// sequence numbers ahead of the last FRAME_LOG_ACK, then FRAME_LOG_END. A transfer
+// that is cut off (bad CRC, timeout, reset) is resumed by asking again from the
+// first sequence number that did not arrive.
+
+// --- FRAME_EVENT payload ---
+#define EVENT_TERMINAL 0          // [1] Terminal ID
+#define EVENT_SEQ 1               // [2] Event log sequence number
+#define EVENT_ROLL 3              // [2] Roll number
+#define EVENT_DIRECTION 5         // [1] 1 = entry, 0 = exit
+#define EVENT_TIME 6              // [4] Terminal clock, seconds since 2000-01-01 00:00:00
+#define EVENT_DURATION 10         // [4] Seconds inside (exits only, 0 for entries)
+#define EVENT_PAYLOAD_SIZE 14
+
+// --- FRAME_CHECKOUT payload: header, then (len - CHK_RECORDS) / CHK_RECORD_SIZE exits ---
+// Every exit in the frame happened at CHK_TIME; their sequence numbers run on from
+// CHK_FIRST_SEQ in record order, skipping 0xFFFF like the log (0xFFFE is followed by 0).
+#define CHK_TERMINAL 0            // [1] Terminal ID
+#define CHK_FIRST_SEQ 1           // [2] Event log sequence number of the first record
+#define CHK_TIME 3                // [4] Checkout time, seconds since 2000-01-01 00:00:00
+#define CHK_RECORDS 7
+#define CHK_REC_ROLL 0            // [2] Roll number
+#define CHK_REC_DURATION 2        // [4] Seconds inside
+#define CHK_RECORD_SIZE 6
+#define CHK_RECORDS_PER_FRAME 8   // 55-byte payload
+
+// --- FRAME_LOG_REQUEST payload ---
+#define REQ_START_SEQ 0           // [2] First sequence number wanted
+#define REQ_WINDOW 2              // [1] Sequence numbers the terminal may run ahead of the ACKs (0 = default)
+#define REQ_PAYLOAD_SIZE 3
+
+// --- FRAME_LOG_ACK payload ---
+#define ACK_NEXT_SEQ 0            // [2] Sequence number after the last one received in order
+#define ACK_PAYLOAD_SIZE 2
+
+// --- FRAME_LOG_DATA payload: len / LOG_RECORD_SIZE records ---
+#define LOG_REC_SEQ 0             // [2] Sequence number
+#define LOG_REC_ROLL 2            // [2] Roll number
+#define LOG_REC_DIRECTION 4       // [1] 1 = entry, 0 = exit
+#define LOG_REC_TIME 5            // [4] Terminal clock, seconds since 2000-01-01 00:00:00
+#define LOG_RECORD_SIZE 9
+#define LOG_RECORDS_PER_FRAME 5   // 45-byte payload, 90% of the line carries records
+
+// --- FRAME_LOG_END payload ---
+#define END_NEXT_SEQ 0            // [2] Sequence number the next event will get
+#define END_OLDEST_SEQ 2          // [2] Oldest sequence number still stored (0xFFFF = log empty)
+#define END_PAYLOAD_SIZE 4
+
+// --- FRAME_TOTALS_REQUEST payload ---
+#define TREQ_ROLL 0               // [2] Roll number
+#define TREQ_PAYLOAD_SIZE 2
+
+// --- FRAME_TOTALS payload: the user's latest day with finished visits ---
+#define TOT_ROLL 0                // [2] Roll number
+#define TOT_DAY 2                 // [2] Days since 2000-01-01 (0xFFFF = no visits yet, or not TOT_OK)
+#define TOT_SECONDS 4             // [4] Time inside over the finished visits that began that day
+#define TOT_VISITS 8              // [1] Finished visits that began that day (stops at 255)
+#define TOT_STATUS 9              // [1] TOT_OK, TOT_UNKNOWN or TOT_NO_EEPROM
+#define TOT_PAYLOAD_SIZE 10
+#define TOT_OK 0                  // The fields above are the stored totals
+#define TOT_UNKNOWN 1             // Roll number not in the directory
+#define TOT_NO_EEPROM 2           // The totals 24LC256 did not answer
+
+#define PROTO_MAX_RX_PAYLOAD 3    // Largest host -> terminal payload
+
+// Fold one byte into a running CRC-16/CCITT-FALSE
+static unsigned int protoCrc16(unsigned int crc, unsigned char data) {
+    crc ^= (unsigned int)data << 8;
+    for (unsigned char i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc & 0xFFFF;
+}
+
+#endif
@@ -0,0 +1,606 @@
+// Attendance log archive and reports for the central system.
+//
+//   attlog import OUT.attlog CSV...
+//       Convert log_download / occupancy_server CSV into one archive file. An event
+//       whose terminal and sequence number came up in the last DEDUP_WINDOW records
+//       of the same CSV counts once (live events and a later log download overlap);
+//       further apart it is the sequence number wrapping. 'log' lines carry no
+//       terminal and take the one of the CSV's live events, if they all share one.
+//       Exits from the stored log carry no duration, so it is taken from the same
+//       user's previous entry in that CSV (0 if there is none).
+//   attlog report [--threads N] [--bucket MIN] [--long HOURS] [--curve CSV] [--anomalies CSV] FILE...
+//       Per-user visits and time inside as CSV on stdout. --curve writes the number
+//       of people inside at the start of every MIN-minute bucket; --anomalies lists
+//       stays longer than HOURS, exits with no entry on record and entries at night.
+//   attlog bench [--records N] [--files F] [--threads N]
+//       Write F synthetic archives with N records between them, time the report
+//       scan over them at 1, 2, 4 ... N threads, and compare with a row-at-a-time scan.
+//
+// Archive layout (little-endian, like the terminal's records): a 64-byte header,
+// then the records in blocks of ATTLOG_BLOCK. Every block stores each field as its
+// own column, so a report streams through the mapped file with unit-stride loops
+// the compiler vectorizes. The last block is zero-padded.
+//   header  [4] "ATLG"  [2] version  [2] ATTLOG_BLOCK  [8] records  [48] zero
+//   block   [4 x B] time  [4 x B] duration  [2 x B] roll  [1 x B] direction
+// time is the terminal clock (seconds since 2000-01-01); duration is the stay in
+// seconds on exits and 0 on entries; direction is 1 for an entry and 0 for an exit.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <set>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "frame.h"
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "archive columns are mapped as host integers");
+
+namespace {
+
+#define ATTLOG_MAGIC "ATLG"
+#define ATTLOG_VERSION 1
+#define ATTLOG_HEADER_SIZE 64
+#define ATTLOG_BLOCK 1024
+#define ATTLOG_TIME_AT 0
+#define ATTLOG_DURATION_AT (ATTLOG_BLOCK * 4)
+#define ATTLOG_ROLL_AT (ATTLOG_BLOCK * 8)
+#define ATTLOG_DIRECTION_AT (ATTLOG_BLOCK * 10)
+#define ATTLOG_BLOCK_SIZE (ATTLOG_BLOCK * 11) // 11264 bytes, a multiple of 64
+#define MAX_ROLL 9999
+#define MAX_BLOCK_BUCKETS 65536 // Buckets one block's stays may span before steps go to the curve one by one
+
+#define NIGHT_FROM (22 * 3600) // Entries between these times of day are anomalies
+#define NIGHT_UNTIL (5 * 3600)
+
+#define DEDUP_WINDOW 32768 // Records a repeated (terminal, seq) may trail the first copy by: half the sequence space
+#define NO_TERMINAL 256    // Terminal of 'log' lines that cannot be told (terminal IDs are one byte)
+
+using Clock = std::chrono::steady_clock;
+
+// One entry or exit, as the terminal's processKey() records it
+struct AttRecord {
+    uint32_t time;
+    uint32_t duration;
+    uint16_t roll;
+    uint8_t direction;
+};
+
+// --------------------------- Archive files ---------------------------
+
+class ArchiveWriter {
+public:
+    explicit ArchiveWriter(const char* path) : file_(std::fopen(path, "wb")), path_(path) {
+        if (!file_) { std::perror(path); return; }
+        std::vector<uint8_t> header(ATTLOG_HEADER_SIZE, 0); // Record count filled in by close()
+        std::fwrite(header.data(), 1, header.size(), file_);
+        block_.assign(ATTLOG_BLOCK_SIZE, 0);
+    }
+    ~ArchiveWriter() { close(); }
+    bool ok() const { return file_ != nullptr; }
+
+    void add(const AttRecord& r) {
+        size_t i = records_ % ATTLOG_BLOCK;
+        putLe32(&block_[ATTLOG_TIME_AT + i * 4], r.time);
+        putLe32(&block_[ATTLOG_DURATION_AT + i * 4], r.duration);
+        putLe16(&block_[ATTLOG_ROLL_AT + i * 2], r.roll);
+        block_[ATTLOG_DIRECTION_AT + i] = r.direction;
+        if (++records_ % ATTLOG_BLOCK == 0) flushBlock();
+    }
+
+    bool close() {
+        if (!file_) return false;
+        if (records_ % ATTLOG_BLOCK) flushBlock();
+        uint8_t header[ATTLOG_HEADER_SIZE] = {};
+        std::memcpy(header, ATTLOG_MAGIC, 4);
+        putLe16(header + 4, ATTLOG_VERSION);
+        putLe16(header + 6, ATTLOG_BLOCK);
+        putLe32(header + 8, static_cast<uint32_t>(records_));
+        putLe32(header + 12, static_cast<uint32_t>(static_cast<uint64_t>(records_) >> 32));
+        std::fseek(file_, 0, SEEK_SET);
+        std::fwrite(header, 1, sizeof(header), file_);
+        bool good = !std::ferror(file_);
+        if (std::fclose(file_) != 0) good = false;
+        file_ = nullptr;
+        if (!good) std::perror(path_.c_str());
+        return good;
+    }
+    uint64_t records() const { return records_; }
+
+private:
+    void flushBlock() {
+        std::fwrite(block_.data(), 1, block_.size(), file_);
+        std::fill(block_.begin(), block_.end(), 0);
+    }
+    FILE* file_;
+    std::string path_;
+    std::vector<uint8_t> block_;
+    uint64_t records_ = 0;
+};
+
+// A read-only mapping of one archive
+class Archive {
+public:
+    bool open(const char* path) {
+        int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) { std::perror(path); return false; }
+        struct stat st{};
+        fstat(fd, &st);
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ >= ATTLOG_HEADER_SIZE) base_ = static_cast<const uint8_t*>(mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0));
+        ::close(fd);
+        if (base_ == MAP_FAILED) base_ = nullptr;
+        if (!base_ || std::memcmp(base_, ATTLOG_MAGIC, 4) || le16(base_ + 4) != ATTLOG_VERSION || le16(base_ + 6) != ATTLOG_BLOCK) {
+            std::fprintf(stderr, "%s: not an attendance archive\n", path);
+            return false;
+        }
+        records_ = le32(base_ + 8) | static_cast<uint64_t>(le32(base_ + 12)) << 32;
+        if (size_ != ATTLOG_HEADER_SIZE + blocks() * ATTLOG_BLOCK_SIZE) {
+            std::fprintf(stderr, "%s: truncated\n", path);
+            return false;
+        }
+        madvise(const_cast<uint8_t*>(base_), size_, MADV_SEQUENTIAL);
+        return true;
+    }
+    Archive() = default;
+    Archive(const Archive&) = delete;
+    ~Archive() { if (base_) munmap(const_cast<uint8_t*>(base_), size_); }
+
+    uint64_t records() const { return records_; }
+    size_t blocks() const { return static_cast<size_t>((records_ + ATTLOG_BLOCK - 1) / ATTLOG_BLOCK); }
+    size_t blockRecords(size_t b) const { return static_cast<size_t>(std::min<uint64_t>(ATTLOG_BLOCK, records_ - b * ATTLOG_BLOCK)); }
+    const uint8_t* block(size_t b) const { return base_ + ATTLOG_HEADER_SIZE + b * ATTLOG_BLOCK_SIZE; }
+
+private:
+    const uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    uint64_t records_ = 0;
+};
+
+// --------------------------- Scans ---------------------------
+
+// Column view of one mapped block
+struct Columns {
+    const uint32_t* time;
+    const uint32_t* dur;
+    const uint16_t* roll;
+    const uint8_t* dir;
+    explicit Columns(const uint8_t* block)
+        : time(reinterpret_cast<const uint32_t*>(block + ATTLOG_TIME_AT)),
+          dur(reinterpret_cast<const uint32_t*>(block + ATTLOG_DURATION_AT)),
+          roll(reinterpret_cast<const uint16_t*>(block + ATTLOG_ROLL_AT)), dir(block + ATTLOG_DIRECTION_AT) {}
+    uint32_t timeAt(size_t i) const { return time[i]; }
+    uint32_t durAt(size_t i) const { return dur[i]; }
+    uint16_t rollAt(size_t i) const { return roll[i]; }
+    uint8_t dirAt(size_t i) const { return dir[i]; }
+};
+
+// The same fields record by record, for the bench's row-layout comparison
+struct Rows {
+    const AttRecord* r;
+    uint32_t timeAt(size_t i) const { return r[i].time; }
+    uint32_t durAt(size_t i) const { return r[i].duration; }
+    uint16_t rollAt(size_t i) const { return r[i].roll; }
+    uint8_t dirAt(size_t i) const { return r[i].direction; }
+};
+
+struct ScanOptions {
+    uint32_t bucketSecs = 15 * 60;
+    uint32_t longSecs = 12 * 3600;
+};
+
+enum AnomalyKind { LONG_STAY = 1, NO_ENTRY = 2, NIGHT_ENTRY = 4 };
+
+struct Anomaly {
+    uint16_t roll;
+    uint8_t kind;
+    uint32_t time, duration;
+
+    bool operator==(const Anomaly& o) const { return roll == o.roll && kind == o.kind && time == o.time && duration == o.duration; }
+};
+// Report order: by time, then roll number (kind and duration only settle exact ties)
+bool anomalyBefore(const Anomaly& a, const Anomaly& b) {
+    return std::tie(a.time, a.roll, a.kind, a.duration) < std::tie(b.time, b.roll, b.kind, b.duration);
+}
+
+// People inside over time, as +1 / -1 steps per bucket (a difference array)
+struct Curve {
+    uint64_t first = 0; // Bucket number of steps[0]
+    std::vector<int64_t> steps;
+
+    void add(uint64_t bucket, int64_t step) {
+        if (steps.empty()) first = bucket;
+        if (bucket < first) {
+            steps.insert(steps.begin(), first - bucket, 0);
+            first = bucket;
+        }
+        if (bucket - first >= steps.size()) steps.resize(bucket - first + 1, 0);
+        steps[bucket - first] += step;
+    }
+    void merge(const Curve& other) {
+        if (other.steps.empty()) return;
+        add(other.first, 0);
+        add(other.first + other.steps.size() - 1, 0); // Now covers other's range
+        for (size_t i = 0; i < other.steps.size(); i++) steps[other.first - first + i] += other.steps[i];
+    }
+    int64_t at(uint64_t bucket) const { return bucket >= first && bucket - first < steps.size() ? steps[bucket - first] : 0; }
+    // Same step in every bucket; zero steps at either end may differ with the block boundaries
+    bool operator==(const Curve& other) const {
+        if (steps.empty() || other.steps.empty()) {
+            auto zero = [](int64_t s) { return s == 0; };
+            return std::all_of(steps.begin(), steps.end(), zero) && std::all_of(other.steps.begin(), other.steps.end(), zero);
+        }
+        uint64_t from = std::min(first, other.first);
+        uint64_t to = std::max(first + steps.size(), other.first + other.steps.size());
+        for (uint64_t b = from; b < to; b++) {
+            if (at(b) != other.at(b)) return false;
+        }
+        return true;
+    }
+};
+
+// One worker's results; merged after the scan
+struct Partial {
+    std::vector<uint64_t> seconds = std::vector<uint64_t>(MAX_ROLL + 1, 0);
+    std::vector<uint32_t> visits = std::vector<uint32_t>(MAX_ROLL + 1, 0);
+    Curve curve;
+    std::vector<Anomaly> anomalies;
+    uint64_t records = 0, badRolls = 0;
+    std::vector<int32_t> blockSteps; // Scratch for scanRecords()
+};
+
+// One block's worth of records. Passes 1 and 3 are branch-free element-wise loops
+// that vectorize; pass 2 scatters into per-user and per-bucket counters.
+template <class View> void scanRecords(const View& v, size_t n, const ScanOptions& opt, Partial& out) {
+    // 1: the time range this block's stays cover (entries count as a stay of 0)
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t start = v.timeAt(i) - v.durAt(i);
+        lo = start < lo ? start : lo;
+        hi = v.timeAt(i) > hi ? v.timeAt(i) : hi;
+    }
+
+    // 2: per-user totals and the occupancy steps, weighted by "is an exit" rather
+    // than branching on it. Entries carry duration 0.
+    uint32_t firstBucket = lo / opt.bucketSecs;
+    size_t span = lo <= hi ? hi / opt.bucketSecs - firstBucket + 1 : 0;
+    bool dense = span <= MAX_BLOCK_BUCKETS; // Steps collect in a flat array, then go to the curve once per bucket
+    std::vector<int32_t>& local = out.blockSteps;
+    if (dense) local.assign(span, 0);
+    for (size_t i = 0; i < n; i++) {
+        uint16_t roll = v.rollAt(i);
+        if (roll > MAX_ROLL) { out.badRolls++; continue; }
+        uint32_t exit = v.dirAt(i) == 0;
+        out.seconds[roll] += v.durAt(i);
+        out.visits[roll] += exit;
+        uint32_t from = (v.timeAt(i) - v.durAt(i)) / opt.bucketSecs, to = v.timeAt(i) / opt.bucketSecs;
+        if (dense) {
+            local[from - firstBucket] += static_cast<int32_t>(exit);
+            local[to - firstBucket] -= static_cast<int32_t>(exit);
+        } else if (exit) {
+            out.curve.add(from, 1);
+            out.curve.add(to, -1);
+        }
+    }
+    if (dense) {
+        for (size_t b = 0; b < span; b++) {
+            if (local[b]) out.curve.add(firstBucket + b, local[b]);
+        }
+    }
+
+    // 3: anomaly flags, then pick out the (rare) flagged records
+    uint8_t flags[ATTLOG_BLOCK];
+    uint8_t any = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t exit = v.dirAt(i) == 0;
+        uint32_t tod = v.timeAt(i) % 86400;
+        uint8_t night = (tod >= NIGHT_FROM) | (tod < NIGHT_UNTIL);
+        flags[i] = static_cast<uint8_t>((exit & (v.durAt(i) > opt.longSecs)) * LONG_STAY | (exit & (v.durAt(i) == 0)) * NO_ENTRY |
+                                        ((exit ^ 1) & night) * NIGHT_ENTRY);
+        any |= flags[i];
+    }
+    if (any) {
+        for (size_t i = 0; i < n; i++) {
+            for (uint8_t k = LONG_STAY; k <= NIGHT_ENTRY; k <<= 1) {
+                if (flags[i] & k) out.anomalies.push_back({v.rollAt(i), k, v.timeAt(i), v.durAt(i)});
+            }
+        }
+    }
+    out.records += n;
+}
+
+// Scan the archives on a pool of worker threads; each takes the next unclaimed
+// file, so one long file does not hold up the rest
+Partial scanArchives(const std::vector<const Archive*>& files, unsigned threads, const ScanOptions& opt) {
+    std::vector<Partial> parts(threads);
+    std::atomic<size_t> nextFile{0};
+    auto worker = [&](Partial& out) {
+        for (size_t f; (f = nextFile.fetch_add(1)) < files.size();) {
+            const Archive& a = *files[f];
+            for (size_t b = 0; b < a.blocks(); b++) scanRecords(Columns(a.block(b)), a.blockRecords(b), opt, out);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker, std::ref(parts[t]));
+    worker(parts[0]);
+    for (std::thread& t : pool) t.join();
+
+    Partial& all = parts[0];
+    for (unsigned t = 1; t < threads; t++) {
+        for (size_t r = 0; r <= MAX_ROLL; r++) {
+            all.seconds[r] += parts[t].seconds[r];
+            all.visits[r] += parts[t].visits[r];
+        }
+        all.curve.merge(parts[t].curve);
+        all.anomalies.insert(all.anomalies.end(), parts[t].anomalies.begin(), parts[t].anomalies.end());
+        all.records += parts[t].records;
+        all.badRolls += parts[t].badRolls;
+    }
+    std::sort(all.anomalies.begin(), all.anomalies.end(), anomalyBefore);
+    return std::move(all);
+}
+
+// --------------------------- Commands ---------------------------
+
+std::vector<std::string> splitCsv(const std::string& line) {
+    std::vector<std::string> fields;
+    std::stringstream in(line);
+    for (std::string f; std::getline(in, f, ',');) fields.push_back(f);
+    if (!line.empty() && line.back() == ',') fields.push_back("");
+    return fields;
+}
+
+// "YYYY-MM-DD HH:MM:SS" as printed by clockText() back to seconds since 2000-01-01
+bool parseClock(const std::string& text, uint32_t& secs) {
+    tm cal{};
+    if (std::sscanf(text.c_str(), "%d-%d-%d %d:%d:%d", &cal.tm_year, &cal.tm_mon, &cal.tm_mday, &cal.tm_hour, &cal.tm_min,
+                    &cal.tm_sec) != 6) return false;
+    cal.tm_year -= 1900;
+    cal.tm_mon -= 1;
+    time_t t = timegm(&cal);
+    if (t < 946684800) return false;
+    secs = static_cast<uint32_t>(t - 946684800);
+    return true;
+}
+
+int importCsv(const char* out, int count, char** csvs) {
+    ArchiveWriter writer(out);
+    if (!writer.ok()) return 1;
+    for (int f = 0; f < count; f++) {
+        std::ifstream in(csvs[f]);
+        if (!in) { std::perror(csvs[f]); return 1; }
+        std::set<unsigned long> terminals; // Of the live events, to give the 'log' lines one
+        std::string line;
+        while (std::getline(in, line)) {
+            std::vector<std::string> c = splitCsv(line);
+            if (c.size() == 7 && c[0] == "event") terminals.insert(std::strtoul(c[1].c_str(), nullptr, 10));
+        }
+        unsigned long logTerminal = terminals.size() == 1 ? *terminals.begin() : NO_TERMINAL;
+        in.clear();
+        in.seekg(0);
+
+        std::unordered_map<uint64_t, uint64_t> seen; // Terminal and seq -> record number it last came up at
+        uint64_t recordNo = 0;
+        std::unordered_map<unsigned int, uint32_t> entered; // Roll -> time of the entry not yet matched
+        for (unsigned int lineNo = 1; std::getline(in, line); lineNo++) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            std::vector<std::string> c = splitCsv(line); // kind,terminal,seq,roll,direction,time,duration
+            if (c.size() != 7 || (c[0] != "event" && c[0] != "log")) continue; // Header or another tool's line
+            AttRecord r{};
+            unsigned long roll = std::strtoul(c[3].c_str(), nullptr, 10);
+            if (!parseClock(c[5], r.time) || roll < 1 || roll > MAX_ROLL || (c[4] != "entry" && c[4] != "exit")) {
+                std::fprintf(stderr, "%s:%u: not an event record\n", csvs[f], lineNo);
+                return 1;
+            }
+            unsigned long terminal = c[1].empty() ? logTerminal : std::strtoul(c[1].c_str(), nullptr, 10);
+            uint64_t key = (static_cast<uint64_t>(terminal) << 16) | (std::strtoul(c[2].c_str(), nullptr, 10) & 0xFFFF);
+            auto s = seen.find(key);
+            if (s != seen.end() && recordNo - s->second < DEDUP_WINDOW) continue; // Seen live and in the log
+            seen[key] = recordNo++;
+            r.roll = static_cast<uint16_t>(roll);
+            r.direction = c[4] == "entry";
+            if (r.direction) entered[r.roll] = r.time;
+            else {
+                auto e = entered.find(r.roll);
+                if (!c[6].empty()) r.duration = static_cast<uint32_t>(std::strtoul(c[6].c_str(), nullptr, 10));
+                else if (e != entered.end() && e->second <= r.time) r.duration = r.time - e->second;
+                if (e != entered.end()) entered.erase(e);
+            }
+            writer.add(r);
+        }
+    }
+    uint64_t records = writer.records();
+    if (!writer.close()) return 1;
+    std::fprintf(stderr, "%s: %llu records\n", out, static_cast<unsigned long long>(records));
+    return 0;
+}
+
+const char* kindText(uint8_t kind) {
+    return kind == LONG_STAY ? "long_stay" : kind == NO_ENTRY ? "no_entry" : "night_entry";
+}
+
+bool writeCurve(const char* path, const Curve& curve, uint32_t bucketSecs, uint64_t& peak, uint64_t& peakBucket) {
+    FILE* f = std::fopen(path, "w");
+    if (!f) { std::perror(path); return false; }
+    std::fprintf(f, "time,inside\n");
+    int64_t inside = 0;
+    peak = peakBucket = 0;
+    for (size_t i = 0; i < curve.steps.size(); i++) {
+        inside += curve.steps[i];
+        if (static_cast<uint64_t>(inside) > peak) { peak = static_cast<uint64_t>(inside); peakBucket = curve.first + i; }
+        std::fprintf(f, "%s,%lld\n", clockText(static_cast<uint32_t>((curve.first + i) * bucketSecs)).c_str(), static_cast<long long>(inside));
+    }
+    return std::fclose(f) == 0;
+}
+
+int report(int argc, char** argv) {
+    ScanOptions opt;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    const char* curvePath = nullptr;
+    const char* anomalyPath = nullptr;
+    std::vector<const char*> paths;
+    for (int i = 0; i < argc; i++) {
+        bool value = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--threads") && value) threads = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--bucket") && value) opt.bucketSecs = static_cast<uint32_t>(std::max(1ul, std::strtoul(argv[++i], nullptr, 10)) * 60);
+        else if (!std::strcmp(argv[i], "--long") && value) opt.longSecs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10) * 3600);
+        else if (!std::strcmp(argv[i], "--curve") && value) curvePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--anomalies") && value) anomalyPath = argv[++i];
+        else if (argv[i][0] == '-') return 2;
+        else paths.push_back(argv[i]);
+    }
+    if (paths.empty()) return 2;
+
+    std::vector<Archive> archives(paths.size());
+    std::vector<const Archive*> files;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!archives[i].open(paths[i])) return 1;
+        files.push_back(&archives[i]);
+    }
+    threads = static_cast<unsigned>(std::min<size_t>(threads, files.size()));
+    auto start = Clock::now();
+    Partial all = scanArchives(files, threads, opt);
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::printf("roll,visits,seconds\n");
+    for (size_t r = 1; r <= MAX_ROLL; r++) {
+        if (all.visits[r]) std::printf("%zu,%u,%llu\n", r, all.visits[r], static_cast<unsigned long long>(all.seconds[r]));
+    }
+    if (curvePath) {
+        uint64_t peak, peakBucket;
+        if (!writeCurve(curvePath, all.curve, opt.bucketSecs, peak, peakBucket)) return 1;
+        std::fprintf(stderr, "peak: %llu inside at %s\n", static_cast<unsigned long long>(peak),
+                     clockText(static_cast<uint32_t>(peakBucket * opt.bucketSecs)).c_str());
+    }
+    if (anomalyPath) {
+        FILE* f = std::fopen(anomalyPath, "w");
+        if (!f) { std::perror(anomalyPath); return 1; }
+        std::fprintf(f, "roll,kind,time,duration\n");
+        for (const Anomaly& a : all.anomalies) std::fprintf(f, "%u,%s,%s,%u\n", a.roll, kindText(a.kind), clockText(a.time).c_str(), a.duration);
+        if (std::fclose(f) != 0) { std::perror(anomalyPath); return 1; }
+    }
+    std::fprintf(stderr, "%zu files, %llu records, %zu anomalies, %llu bad roll numbers in %.3f s on %u threads\n", files.size(),
+                 static_cast<unsigned long long>(all.records), all.anomalies.size(), static_cast<unsigned long long>(all.badRolls),
+                 secs, threads);
+    return 0;
+}
+
+// 90 days of visits by random users, day by day as a site's log grows: mostly day
+// shifts, with a few night entries and stays long enough to be forgotten exits
+void syntheticFile(ArchiveWriter& w, std::vector<AttRecord>& rows, uint64_t records, std::mt19937& rng) {
+    const uint32_t day0 = 846979200; // 2026-10-16
+    for (uint64_t i = 0; i + 1 < records; i += 2) {
+        uint16_t roll = static_cast<uint16_t>(1000 + rng() % 2000);
+        uint32_t day = day0 + static_cast<uint32_t>(i * 90 / records) * 86400;
+        uint32_t start = day + (rng() % 100 < 3 ? 23 * 3600 : 7 * 3600 + rng() % (4 * 3600));
+        uint32_t stay = rng() % 100 < 1 ? 13 * 3600 + rng() % (20 * 3600) : 600 + rng() % (9 * 3600);
+        AttRecord in{start, 0, roll, 1}, out{start + stay, stay, roll, 0};
+        w.add(in);
+        w.add(out);
+        rows.push_back(in);
+        rows.push_back(out);
+    }
+}
+
+int bench(int argc, char** argv) {
+    uint64_t records = 8000000;
+    unsigned fileCount = 8, maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i + 1 < argc; i += 2) {
+        if (!std::strcmp(argv[i], "--records")) records = std::strtoull(argv[i + 1], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--files")) fileCount = static_cast<unsigned>(std::max(1ul, std::strtoul(argv[i + 1], nullptr, 10)));
+        else if (!std::strcmp(argv[i], "--threads")) maxThreads = static_cast<unsigned>(std::max(1ul, std::strtoul(argv[i + 1], nullptr, 10)));
+        else return 2;
+    }
+    if (argc % 2) return 2;
+
+    char dir[] = "/tmp/attlog_bench.XXXXXX";
+    if (!mkdtemp(dir)) { std::perror("mkdtemp"); return 1; }
+    std::mt19937 rng(2301);
+    std::vector<AttRecord> rows; // The same records in row layout
+    std::vector<std::string> paths;
+    for (unsigned f = 0; f < fileCount; f++) {
+        paths.push_back(std::string(dir) + "/site" + std::to_string(f) + ".attlog");
+        ArchiveWriter w(paths.back().c_str());
+        if (!w.ok()) return 1;
+        syntheticFile(w, rows, records / fileCount, rng);
+        if (!w.close()) return 1;
+    }
+    std::vector<Archive> archives(paths.size());
+    std::vector<const Archive*> files;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!archives[i].open(paths[i].c_str())) return 1;
+        files.push_back(&archives[i]);
+    }
+    std::printf("%zu records in %u files, %.1f MB mapped\n", rows.size(), fileCount,
+                static_cast<double>(rows.size()) * 11 / 1e6);
+
+    ScanOptions opt;
+    auto best = [](auto&& run) {
+        double fastest = 1e30;
+        for (int rep = 0; rep < 3; rep++) {
+            auto start = Clock::now();
+            run();
+            fastest = std::min(fastest, std::chrono::duration<double>(Clock::now() - start).count());
+        }
+        return fastest;
+    };
+
+    Partial rowResult;
+    double rowSecs = best([&] {
+        rowResult = Partial();
+        for (size_t at = 0; at < rows.size(); at += ATTLOG_BLOCK) {
+            scanRecords(Rows{rows.data() + at}, std::min<size_t>(ATTLOG_BLOCK, rows.size() - at), opt, rowResult);
+        }
+    });
+    std::printf("row layout,   1 thread : %7.1f M records/s\n", static_cast<double>(rows.size()) / rowSecs / 1e6);
+    std::sort(rowResult.anomalies.begin(), rowResult.anomalies.end(), anomalyBefore); // As scanArchives() leaves them
+
+    bool same = true;
+    for (unsigned t = 1; t <= maxThreads; t *= 2) {
+        Partial result;
+        double secs = best([&] { result = scanArchives(files, t, opt); });
+        std::printf("column blocks, %2u thread%s: %7.1f M records/s\n", t, t == 1 ? " " : "s", static_cast<double>(result.records) / secs / 1e6);
+        same = same && result.seconds == rowResult.seconds && result.visits == rowResult.visits &&
+               result.anomalies == rowResult.anomalies && result.curve == rowResult.curve && result.records == rowResult.records;
+        if (t < maxThreads && t * 2 > maxThreads) t = maxThreads / 2; // Finish on maxThreads itself
+    }
+    std::printf("results %s\n", same ? "agree" : "DIFFER between the layouts");
+
+    for (const std::string& p : paths) ::unlink(p.c_str());
+    ::rmdir(dir);
+    return same ? 0 : 1;
+}
+
+void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s import OUT.attlog CSV...\n"
+                 "       %s report [--threads N] [--bucket MIN] [--long HOURS] [--curve CSV] [--anomalies CSV] FILE...\n"
+                 "       %s bench [--records N] [--files F] [--threads N]\n",
+                 argv0, argv0, argv0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int status = 2;
+    if (argc >= 4 && !std::strcmp(argv[1], "import")) status = importCsv(argv[2], argc - 3, argv + 3);
+    else if (argc >= 3 && !std::strcmp(argv[1], "report")) status = report(argc - 2, argv + 2);
+    else if (argc >= 2 && !std::strcmp(argv[1], "bench")) status = bench(argc - 2, argv + 2);
+    if (status == 2) usage(argv[0]);
+    return status;
+}
@@ -0,0 +1,88 @@
+// Build the external directory EEPROM image (directory.h) for a 24LC256.
+//
+//   dir_image ROSTER.csv OUT.bin
+//       ROSTER.csv as read by tools/roster.h; it does not need to be sorted.
+//   dir_image --synthetic N OUT.bin
+//       N made-up users with roll numbers from 1000 on, for the simulator.
+//
+// Program OUT.bin into the EEPROM with any 24xx programmer, or hand it to
+// attendence_sim -x.
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "directory.h"
+#include "roster.h"
+
+namespace {
+
+void put16(std::vector<uint8_t>& img, size_t at, unsigned int v) {
+    img[at] = static_cast<uint8_t>(v);
+    img[at + 1] = static_cast<uint8_t>(v >> 8);
+}
+
+size_t pageAlign(size_t addr) { return (addr + DIR_PAGE_SIZE - 1) / DIR_PAGE_SIZE * DIR_PAGE_SIZE; }
+
+void synthetic(unsigned long count, std::vector<RosterUser>& users) {
+    static const char* first[] = {"Aarav", "Diya", "Arjun", "Ananya", "Ishaan", "Siya", "Vihaan", "Aanya", "Advait", "Avni"};
+    for (unsigned long i = 0; i < count; i++) {
+        users.push_back({static_cast<unsigned int>(1000 + i), first[i % 10], 0});
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<RosterUser> users;
+    const char* out;
+    if (argc == 4 && !std::strcmp(argv[1], "--synthetic")) {
+        unsigned long count = std::strtoul(argv[2], nullptr, 10);
+        if (count > 9999 - 1000 + 1) { std::fprintf(stderr, "at most 9000 synthetic users\n"); return 2; }
+        synthetic(count, users);
+        out = argv[3];
+    } else if (argc == 3 && argv[1][0] != '-') {
+        if (!readRoster(argv[1], users)) return 1;
+        out = argv[2];
+    } else {
+        std::fprintf(stderr, "usage: %s ROSTER.csv OUT.bin\n       %s --synthetic N OUT.bin\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    size_t pages = (users.size() + DIR_ENTRIES_PER_PAGE - 1) / DIR_ENTRIES_PER_PAGE;
+    size_t indexAddr = pageAlign(DIR_FENCE_ADDR + pages * 2);
+    size_t namesAddr = indexAddr + pages * DIR_PAGE_SIZE;
+    size_t end = namesAddr;
+    for (const RosterUser& u : users) end += u.name.size() + 1;
+    if (end > DIR_DEVICE_SIZE) {
+        std::fprintf(stderr, "%zu users need %zu bytes, the 24LC256 has %d\n", users.size(), end, DIR_DEVICE_SIZE);
+        return 1;
+    }
+
+    std::vector<uint8_t> img(DIR_DEVICE_SIZE, 0xFF); // Untouched cells stay erased
+    img[DIR_HDR_MAGIC] = 'U';
+    img[DIR_HDR_MAGIC + 1] = 'D';
+    img[DIR_HDR_VERSION] = DIR_VERSION;
+    put16(img, DIR_HDR_COUNT, static_cast<unsigned int>(users.size()));
+    put16(img, DIR_HDR_PAGES, static_cast<unsigned int>(pages));
+    put16(img, DIR_HDR_INDEX, static_cast<unsigned int>(indexAddr));
+    put16(img, DIR_HDR_NAMES, static_cast<unsigned int>(namesAddr));
+    size_t nameAt = namesAddr;
+    for (size_t i = 0; i < users.size(); i++) {
+        if (i % DIR_ENTRIES_PER_PAGE == 0) put16(img, DIR_FENCE_ADDR + i / DIR_ENTRIES_PER_PAGE * 2, users[i].id);
+        size_t entry = indexAddr + i / DIR_ENTRIES_PER_PAGE * DIR_PAGE_SIZE + i % DIR_ENTRIES_PER_PAGE * DIR_ENTRY_SIZE;
+        put16(img, entry, users[i].id);
+        put16(img, entry + 2, static_cast<unsigned int>(nameAt));
+        std::memcpy(&img[nameAt], users[i].name.c_str(), users[i].name.size() + 1);
+        nameAt += users[i].name.size() + 1;
+    }
+
+    std::ofstream file(out, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(img.data()), static_cast<std::streamsize>(img.size()));
+    if (!file) { std::perror(out); return 1; }
+    std::fprintf(stderr, "%zu users, %zu index pages, %zu of %d bytes used\n", users.size(), pages, end, DIR_DEVICE_SIZE);
+    return 0;
+}
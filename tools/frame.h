@@ -0,0 +1,132 @@
+// Serial link frames (protocol.h) for the host tools (log_download, occupancy_server,
+// occupancy_load): little-endian field access, frame encoding and a resyncing parser.
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "protocol.h"
+
+struct Frame {
+    uint8_t type = 0;
+    std::vector<uint8_t> payload;
+};
+
+inline uint16_t le16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+inline uint32_t le32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+inline void putLe16(uint8_t* p, unsigned int v) {
+    p[0] = static_cast<uint8_t>(v);
+    p[1] = static_cast<uint8_t>(v >> 8);
+}
+inline void putLe32(uint8_t* p, uint32_t v) {
+    putLe16(p, v & 0xFFFF);
+    putLe16(p + 2, v >> 16);
+}
+
+// Sequence number after 'seq'; the terminal skips 0xFFFF, which marks an empty log slot
+inline uint16_t seqAfter(uint16_t seq) { return seq == 0xFFFE ? 0 : static_cast<uint16_t>(seq + 1); }
+// Sequence numbers from 'from' up to (not including) 'to', with 0xFFFF skipped
+inline uint16_t seqDistance(uint16_t from, uint16_t to) {
+    uint16_t n = static_cast<uint16_t>(to - from);
+    return (to < from && n) ? static_cast<uint16_t>(n - 1) : n; // The run passed 0xFFFE -> 0
+}
+
+// Append one complete frame (sync, header, payload, CRC) to 'out'
+inline void encodeFrame(std::vector<uint8_t>& out, uint8_t type, const uint8_t* payload, size_t len) {
+    size_t start = out.size();
+    out.push_back(PROTO_SYNC);
+    out.push_back(type);
+    out.push_back(static_cast<uint8_t>(len));
+    out.insert(out.end(), payload, payload + len);
+    unsigned int crc = PROTO_CRC_INIT;
+    for (size_t i = start + 1; i < out.size(); i++) crc = protoCrc16(crc, out[i]);
+    out.push_back(static_cast<uint8_t>(crc));
+    out.push_back(static_cast<uint8_t>(crc >> 8));
+}
+
+// Terminal time (seconds since 2000-01-01, in the terminal's local time) as text
+inline std::string clockText(uint32_t secs) {
+    const time_t epoch2000 = 946684800; // 2000-01-01 00:00:00 as a Unix time
+    time_t t = epoch2000 + static_cast<time_t>(secs);
+    tm cal{};
+    gmtime_r(&t, &cal); // Taken as UTC so no time zone shifts it again
+    char text[24];
+    std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &cal);
+    return text;
+}
+
+// Frame parser; skips to the next sync byte after anything malformed
+class FrameParser {
+public:
+    // Feed one byte. Returns true when 'out' holds a complete, CRC-checked frame.
+    bool push(uint8_t b, Frame& out) {
+        buf_.push_back(b);
+        uint8_t type;
+        const uint8_t* payload;
+        size_t len;
+        bool got = next(type, payload, len);
+        if (got) {
+            out.type = type;
+            out.payload.assign(payload, payload + len);
+        }
+        compact();
+        return got;
+    }
+
+    // Feed a whole read() at once. onFrame(type, payload, len) runs for every complete
+    // frame, in order; the payload points into the parser and is only valid during the call.
+    template <class OnFrame> void feed(const uint8_t* data, size_t n, OnFrame&& onFrame) {
+        buf_.insert(buf_.end(), data, data + n);
+        uint8_t type;
+        const uint8_t* payload;
+        size_t len;
+        while (next(type, payload, len)) onFrame(type, payload, len);
+        compact();
+    }
+    unsigned long badFrames() const { return bad_; }
+
+private:
+    // Next CRC-checked frame from pos_ on. Stops at an incomplete tail, which stays buffered.
+    bool next(uint8_t& type, const uint8_t*& payload, size_t& len) {
+        while (pos_ < buf_.size()) {
+            const void* sync = std::memchr(&buf_[pos_], PROTO_SYNC, buf_.size() - pos_);
+            if (!sync) { pos_ = buf_.size(); return false; }
+            pos_ = static_cast<size_t>(static_cast<const uint8_t*>(sync) - buf_.data());
+            size_t avail = buf_.size() - pos_;
+            if (avail < 3) return false;
+            size_t total = PROTO_OVERHEAD + buf_[pos_ + 2];
+            if (avail < total) return false;
+            const uint8_t* f = &buf_[pos_];
+            unsigned int crc = PROTO_CRC_INIT;
+            for (size_t i = 1; i < total - 2; i++) crc = protoCrc16(crc, f[i]);
+            if (f[total - 2] != (crc & 0xFF) || f[total - 1] != (crc >> 8)) {
+                bad_++;
+                pos_++; // Not a frame after all: look for the next sync byte
+                continue;
+            }
+            type = f[1];
+            payload = f + 3;
+            len = total - PROTO_OVERHEAD;
+            pos_ += total;
+            return true;
+        }
+        return false;
+    }
+    void compact() {
+        buf_.erase(buf_.begin(), buf_.begin() + static_cast<long>(pos_));
+        pos_ = 0;
+    }
+    std::vector<uint8_t> buf_;
+    size_t pos_ = 0; // Bytes before this are consumed
+    unsigned long bad_ = 0;
+};
+
+#endif
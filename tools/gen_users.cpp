@@ -0,0 +1,102 @@
+// Generate the program-memory user table (users_table.h) from a roster CSV.
+//
+//   gen_users ROSTER.csv OUT.h
+//
+// The roster is read and checked by tools/roster.h. The output is a struct of
+// arrays: the roll numbers as sorted 16-bit integers for lookupUser()'s binary
+// search, and the names packed back to back in one pool. An offset into the pool
+// is kept for every NAME_BLOCK users only; lookupUser() steps over the few names
+// before the one it wants. That puts a user at 2.25 program words plus the name.
+// Static checks fail the firmware build (XC8 or host) if the table outgrows
+// USER_TABLE_MAX_WORDS, or if the IDs are not strictly ascending: each ID is a
+// USER_ID_n macro that both the array and the checks use, so a hand edit to one is
+// checked too. gen_users checks the order itself before it writes anything, and
+// host/users_table_test (ctest) checks the arrays of the checked-in file. The CMake
+// build writes OUT.h into its build directory; the copy next to attendence.c is
+// checked in, so MPLAB builds need no host tools.
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "roster.h"
+
+namespace {
+
+#define NAME_BLOCK 8 // Users per name-pool offset
+
+std::string generate(std::string rosterName, const std::vector<RosterUser>& users) {
+    size_t pool = 0;
+    for (const RosterUser& u : users) pool += u.name.size() + 1;
+    unsigned int probes = 0;
+    for (size_t n = users.size(); n; n >>= 1) probes++;
+
+    std::ostringstream out;
+    out << "// Generated by tools/gen_users from " << rosterName << " - do not edit, change the roster.\n"
+        << "// Included once, by attendence.c (program-memory directory).\n"
+        << "#define USER_COUNT " << users.size() << "\n"
+        << "#define USER_NAME_POOL_SIZE " << pool << "  // Name bytes, terminators included\n"
+        << "#define USER_LOOKUP_PROBES " << probes << "    // Worst-case binary search probes\n"
+        << "#define USER_NAME_BLOCK " << NAME_BLOCK << "       // Users per userNameBlockAt entry\n"
+        << "#define USER_NAME_BLOCKS ((USER_COUNT + USER_NAME_BLOCK - 1) / USER_NAME_BLOCK)\n"
+        << "#define USER_TABLE_WORDS (USER_COUNT * 2 + USER_NAME_BLOCKS * 2 + USER_NAME_POOL_SIZE) // One RETLW per byte\n\n";
+
+    out << "// Roll numbers, sorted ascending (macros, so the checks at the end read the same values)\n";
+    for (size_t i = 0; i < users.size(); i++) out << "#define USER_ID_" << i << " " << users[i].id << "\n";
+    out << "const unsigned int userIds[USER_COUNT] = {";
+    for (size_t i = 0; i < users.size(); i++) out << (i % 10 ? " " : "\n    ") << "USER_ID_" << i << ",";
+    out << "\n};\n";
+
+    out << "// Where the names of users i * USER_NAME_BLOCK on start in userNames\n"
+        << "const unsigned int userNameBlockAt[USER_NAME_BLOCKS] = {";
+    size_t at = 0;
+    for (size_t i = 0; i < users.size(); i++) {
+        if (i % NAME_BLOCK == 0) out << (i % (NAME_BLOCK * 10) ? " " : "\n    ") << at << ",";
+        at += users[i].name.size() + 1;
+    }
+    out << "\n};\n";
+
+    out << "// Names in userIds order, terminated and packed back to back\n"
+        << "const char userNames[USER_NAME_POOL_SIZE] =";
+    for (size_t i = 0; i < users.size(); i++) out << (i % 5 ? " " : "\n    ") << "\"" << users[i].name << "\\0\"";
+    out << ";\n\n";
+
+    out << "// Strictly ascending IDs: no duplicates, and the binary search holds\n";
+    for (size_t i = 1, chunk = 0; i < users.size(); chunk++) {
+        out << "typedef char users_sorted_" << chunk << "[(";
+        for (size_t n = 0; n < 8 && i < users.size(); n++, i++) {
+            out << (n ? " && " : "") << "USER_ID_" << i - 1 << " < USER_ID_" << i;
+        }
+        out << ") ? 1 : -1];\n";
+    }
+    out << "typedef char users_fit_rom[(USER_TABLE_WORDS <= USER_TABLE_MAX_WORDS) ? 1 : -1];\n";
+    return out.str();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: %s ROSTER.csv OUT.h\n", argv[0]);
+        return 2;
+    }
+    std::vector<RosterUser> users;
+    if (!readRoster(argv[1], users)) return 1;
+    if (users.empty()) { std::fprintf(stderr, "%s: no users\n", argv[1]); return 1; }
+    for (size_t i = 1; i < users.size(); i++) { // lookupUser()'s binary search needs it; never write a table without it
+        if (users[i - 1].id < users[i].id) continue;
+        std::fprintf(stderr, "%s: roll numbers %u and %u out of order, nothing written\n", argv[1], users[i - 1].id, users[i].id);
+        return 1;
+    }
+
+    std::string roster = argv[1];
+    std::string text = generate(roster.substr(roster.find_last_of('/') + 1), users); // No build paths in the checked-in file
+    std::ofstream file(argv[2], std::ios::binary | std::ios::trunc);
+    file << text;
+    if (!file) { std::perror(argv[2]); return 1; }
+    size_t words = users.size() * 2 + (users.size() + NAME_BLOCK - 1) / NAME_BLOCK * 2;
+    for (const RosterUser& u : users) words += u.name.size() + 1;
+    std::fprintf(stderr, "%s: %zu users, %zu program words\n", argv[2], users.size(), words);
+    return 0;
+}
@@ -0,0 +1,313 @@
+// Host side of the terminal's serial link (protocol.h).
+//
+//   log_download DEVICE [--from SEQ] [--window N] [--state FILE] [--timeout MS]
+//       Pull the stored event log over the serial port (115200 8N1) and print it as
+//       CSV. Every in-order FRAME_LOG_DATA is acknowledged straight away so the
+//       terminal keeps the line busy. Records are only taken in sequence order: a
+//       frame that starts past the first missing record (one before it was lost) or
+//       a timeout resumes the transfer with a new request from that record. With
+//       --state the next sequence number is kept in FILE, so the next run (or a rerun
+//       after a cable pull) continues where this one stopped.
+//
+//   log_download DEVICE --totals ROLL [--timeout MS]
+//       Ask for one user's daily totals (time inside and visits for the latest day
+//       with finished visits) and print them as CSV. An unknown roll number, or a
+//       terminal whose totals EEPROM does not answer, is reported on stderr instead
+//       (exit status 1).
+//
+//   log_download --decode FILE
+//       Decode a raw capture of terminal output (e.g. attendence_sim -u) to CSV.
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "frame.h"
+
+namespace {
+
+// Day number (days since 2000-01-01) as a date
+std::string dayText(unsigned int day) { return clockText(static_cast<uint32_t>(day) * 86400u).substr(0, 10); }
+
+// What a FRAME_TOTALS status other than TOT_OK means
+const char* totalsError(uint8_t status) {
+    if (status == TOT_UNKNOWN) return "roll number not in the terminal's directory";
+    if (status == TOT_NO_EEPROM) return "the terminal's totals EEPROM is not answering";
+    return "unknown status";
+}
+
+void printHeader() { std::printf("kind,terminal,seq,roll,direction,time,duration\n"); }
+
+// Print a frame as CSV. Returns false for frames this tool does not know.
+bool printFrame(const Frame& f) {
+    const uint8_t* p = f.payload.data();
+    if (f.type == FRAME_EVENT && f.payload.size() == EVENT_PAYLOAD_SIZE) {
+        std::printf("event,%u,%u,%u,%s,%s,%u\n", p[EVENT_TERMINAL], le16(p + EVENT_SEQ), le16(p + EVENT_ROLL),
+                    p[EVENT_DIRECTION] ? "entry" : "exit", clockText(le32(p + EVENT_TIME)).c_str(),
+                    le32(p + EVENT_DURATION));
+        return true;
+    }
+    if (f.type == FRAME_CHECKOUT && f.payload.size() > CHK_RECORDS &&
+        (f.payload.size() - CHK_RECORDS) % CHK_RECORD_SIZE == 0) {
+        uint16_t seq = le16(p + CHK_FIRST_SEQ);
+        std::string at = clockText(le32(p + CHK_TIME));
+        for (size_t off = CHK_RECORDS; off < f.payload.size(); off += CHK_RECORD_SIZE, seq = seqAfter(seq)) {
+            std::printf("event,%u,%u,%u,exit,%s,%u\n", p[CHK_TERMINAL], seq, le16(p + off + CHK_REC_ROLL), at.c_str(),
+                        le32(p + off + CHK_REC_DURATION));
+        }
+        return true;
+    }
+    if (f.type == FRAME_LOG_DATA && f.payload.size() % LOG_RECORD_SIZE == 0) {
+        for (size_t off = 0; off < f.payload.size(); off += LOG_RECORD_SIZE) {
+            const uint8_t* r = p + off;
+            std::printf("log,,%u,%u,%s,%s,\n", le16(r + LOG_REC_SEQ), le16(r + LOG_REC_ROLL),
+                        r[LOG_REC_DIRECTION] ? "entry" : "exit", clockText(le32(r + LOG_REC_TIME)).c_str());
+        }
+        return true;
+    }
+    if (f.type == FRAME_TOTALS && f.payload.size() == TOT_PAYLOAD_SIZE) {
+        unsigned int day = le16(p + TOT_DAY);
+        if (p[TOT_STATUS] != TOT_OK) std::fprintf(stderr, "totals for %u: %s\n", le16(p + TOT_ROLL), totalsError(p[TOT_STATUS]));
+        else if (day == 0xFFFF) std::fprintf(stderr, "totals for %u: no visits yet\n", le16(p + TOT_ROLL));
+        else std::fprintf(stderr, "totals for %u on %s: %u visits, %u s inside\n", le16(p + TOT_ROLL),
+                          dayText(day).c_str(), p[TOT_VISITS], le32(p + TOT_SECONDS));
+        return true;
+    }
+    if (f.type == FRAME_LOG_END && f.payload.size() == END_PAYLOAD_SIZE) {
+        std::fprintf(stderr, "end of log: next seq %u, oldest stored %u\n", le16(p + END_NEXT_SEQ),
+                     le16(p + END_OLDEST_SEQ));
+        return true;
+    }
+    return false;
+}
+
+int decodeFile(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) { std::perror(path); return 2; }
+    FrameParser parser;
+    Frame f;
+    unsigned long frames = 0, unknown = 0;
+    printHeader();
+    for (int c; (c = in.get()) != EOF;) {
+        if (!parser.push(static_cast<uint8_t>(c), f)) continue;
+        frames++;
+        if (!printFrame(f)) unknown++;
+    }
+    std::fprintf(stderr, "%lu frames, %lu unknown, %lu bad\n", frames, unknown, parser.badFrames());
+    return 0;
+}
+
+class SerialPort {
+public:
+    explicit SerialPort(const char* path) {
+        fd_ = ::open(path, O_RDWR | O_NOCTTY);
+        if (fd_ < 0) return;
+        termios tio{};
+        if (tcgetattr(fd_, &tio) == 0) { // Not a tty (e.g. a pipe or socket): use as is
+            cfmakeraw(&tio);
+            cfsetispeed(&tio, B115200);
+            cfsetospeed(&tio, B115200);
+            tio.c_cflag |= CLOCAL | CREAD;
+            tio.c_cc[VMIN] = 0;
+            tio.c_cc[VTIME] = 0;
+            tcsetattr(fd_, TCSANOW, &tio);
+            tcflush(fd_, TCIOFLUSH);
+        }
+    }
+    ~SerialPort() { if (fd_ >= 0) ::close(fd_); }
+    bool ok() const { return fd_ >= 0; }
+
+    bool sendFrame(uint8_t type, const std::vector<uint8_t>& payload) {
+        std::vector<uint8_t> frame;
+        encodeFrame(frame, type, payload.data(), payload.size());
+        return ::write(fd_, frame.data(), frame.size()) == static_cast<ssize_t>(frame.size());
+    }
+
+    // Next complete frame, or nothing if timeoutMs passes without one
+    std::optional<Frame> readFrame(int timeoutMs) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        Frame f;
+        while (true) {
+            while (pos_ < len_) {
+                if (parser_.push(buf_[pos_++], f)) return f;
+            }
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) return std::nullopt;
+            pollfd pfd{fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, static_cast<int>(left.count())) <= 0) return std::nullopt;
+            ssize_t n = ::read(fd_, buf_, sizeof(buf_));
+            if (n <= 0) return std::nullopt;
+            pos_ = 0;
+            len_ = static_cast<size_t>(n);
+        }
+    }
+    unsigned long badFrames() const { return parser_.badFrames(); }
+
+private:
+    int fd_ = -1;
+    FrameParser parser_;
+    uint8_t buf_[512];
+    size_t pos_ = 0, len_ = 0;
+};
+
+std::vector<uint8_t> seqPayload(uint16_t seq) { return {static_cast<uint8_t>(seq), static_cast<uint8_t>(seq >> 8)}; }
+
+// Records are only printed and acknowledged in sequence order. A LOG_DATA frame that
+// starts past the first missing record means a frame was lost (bad CRC, overrun), so
+// the download is asked for again from that record instead of acknowledging the hole.
+// A hole the terminal keeps sending around after GAP_REQUESTS requests in a row is
+// records it no longer stores: that is reported and the download goes on after it.
+constexpr unsigned int GAP_REQUESTS = 3;
+constexpr unsigned int MAX_STALLS = 5; // Requests in a row without progress before giving up
+
+int download(const char* device, uint16_t from, uint8_t window, const char* stateFile, int timeoutMs) {
+    if (stateFile) {
+        std::ifstream state(stateFile);
+        unsigned long saved;
+        if (state >> saved) from = static_cast<uint16_t>(saved);
+    }
+    SerialPort port(device);
+    if (!port.ok()) { std::perror(device); return 2; }
+
+    uint16_t next = from;        // First sequence number we still need
+    unsigned long records = 0, resumes = 0, gaps = 0;
+    unsigned int stalls = 0;     // Requests since the last record in order
+    bool gapOpen = false;        // A request went out for a hole and has not been answered in order yet
+    bool gapSeen = false;        // Some frame since the last progress started past 'next'
+    uint16_t gapFirst = 0;       // Lowest first sequence number of those frames
+    auto started = std::chrono::steady_clock::now();
+    auto saveState = [&] {
+        if (!stateFile) return;
+        std::ofstream state(stateFile, std::ios::trunc);
+        state << next << "\n";
+    };
+    auto request = [&] {
+        port.sendFrame(FRAME_LOG_REQUEST, {static_cast<uint8_t>(next), static_cast<uint8_t>(next >> 8), window});
+    };
+    // Ask again from 'next'; false once the terminal has had enough chances
+    auto resume = [&] {
+        if (++stalls > MAX_STALLS) {
+            std::fprintf(stderr, "no progress from terminal, giving up at seq %u\n", next);
+            return false;
+        }
+        if (gapSeen && stalls >= GAP_REQUESTS) { // Answered the same way every time: not stored any more
+            std::fprintf(stderr, "records %u-%u are no longer stored on the terminal\n", next,
+                         static_cast<uint16_t>(gapFirst - 1));
+            next = gapFirst;
+            gapSeen = false;
+            stalls = 0;
+        }
+        resumes++;
+        request();
+        return true;
+    };
+
+    printHeader();
+    request();
+    while (true) {
+        std::optional<Frame> f = port.readFrame(timeoutMs);
+        if (!f) { // Lost frame or a stalled terminal: resume from the first missing record
+            gapOpen = false;
+            if (!resume()) return 1;
+            continue;
+        }
+        if (f->type == FRAME_EVENT || f->type == FRAME_CHECKOUT) { printFrame(*f); continue; } // Live traffic interleaves with the download
+        if (f->type == FRAME_LOG_END) {
+            if (gapOpen || gapSeen) continue; // End of a transfer with a hole in it; the new request is under way
+            printFrame(*f);
+            break;
+        }
+        if (f->type != FRAME_LOG_DATA || f->payload.empty() || f->payload.size() % LOG_RECORD_SIZE) continue;
+
+        uint16_t first = le16(f->payload.data() + LOG_REC_SEQ);
+        if (first != next) {
+            if (static_cast<int16_t>(first - next) < 0) continue; // Duplicate after a resume
+            if (!gapSeen || static_cast<int16_t>(first - gapFirst) < 0) gapFirst = first;
+            gapSeen = true;
+            if (gapOpen) continue; // More of the transfer that lost the frame
+            gaps++;
+            gapOpen = true;
+            if (!resume()) return 1;
+            continue;
+        }
+        printFrame(*f);
+        records += f->payload.size() / LOG_RECORD_SIZE;
+        next = seqAfter(le16(f->payload.data() + f->payload.size() - LOG_RECORD_SIZE + LOG_REC_SEQ));
+        stalls = 0;
+        gapOpen = gapSeen = false;
+        port.sendFrame(FRAME_LOG_ACK, seqPayload(next));
+        saveState();
+    }
+    saveState();
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::fprintf(stderr, "%lu records in %.2f s, %lu gaps, %lu resumes, %lu bad frames\n", records, secs, gaps, resumes,
+                 port.badFrames());
+    return 0;
+}
+
+int queryTotals(const char* device, uint16_t roll, int timeoutMs) {
+    SerialPort port(device);
+    if (!port.ok()) { std::perror(device); return 2; }
+    for (int attempt = 0; attempt < 5; attempt++) {
+        port.sendFrame(FRAME_TOTALS_REQUEST, seqPayload(roll)); // Roll number, same layout as a sequence number
+        while (std::optional<Frame> f = port.readFrame(timeoutMs)) {
+            const uint8_t* p = f->payload.data();
+            if (f->type != FRAME_TOTALS || f->payload.size() != TOT_PAYLOAD_SIZE || le16(p + TOT_ROLL) != roll) continue;
+            unsigned int day = le16(p + TOT_DAY);
+            if (p[TOT_STATUS] != TOT_OK) {
+                std::fprintf(stderr, "totals for %u: %s\n", roll, totalsError(p[TOT_STATUS]));
+                return 1;
+            }
+            std::printf("roll,date,visits,seconds\n");
+            if (day == 0xFFFF) std::printf("%u,,0,0\n", roll);
+            else std::printf("%u,%s,%u,%u\n", roll, dayText(day).c_str(), p[TOT_VISITS], le32(p + TOT_SECONDS));
+            return 0;
+        }
+    }
+    std::fprintf(stderr, "no answer from terminal\n");
+    return 1;
+}
+
+void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s DEVICE [--from SEQ] [--window N] [--state FILE] [--timeout MS]\n"
+                 "       %s DEVICE --totals ROLL [--timeout MS]\n"
+                 "       %s --decode FILE\n",
+                 argv0, argv0, argv0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 3 && !std::strcmp(argv[1], "--decode")) return decodeFile(argv[2]);
+    if (argc < 2 || argv[1][0] == '-') { usage(argv[0]); return 2; }
+
+    uint16_t from = 0;
+    uint8_t window = 0; // Terminal default
+    const char* stateFile = nullptr;
+    int timeoutMs = 1000;
+    long totalsRoll = -1;
+    for (int i = 2; i < argc; i++) {
+        if (i + 1 >= argc) { usage(argv[0]); return 2; }
+        if (!std::strcmp(argv[i], "--from")) from = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--window")) window = static_cast<uint8_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (!std::strcmp(argv[i], "--state")) stateFile = argv[++i];
+        else if (!std::strcmp(argv[i], "--timeout")) timeoutMs = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--totals")) totalsRoll = std::strtol(argv[++i], nullptr, 10);
+        else { usage(argv[0]); return 2; }
+    }
+    if (totalsRoll >= 0) return queryTotals(argv[1], static_cast<uint16_t>(totalsRoll), timeoutMs);
+    return download(argv[1], from, window, stateFile, timeoutMs);
+}
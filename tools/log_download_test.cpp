@@ -0,0 +1,220 @@
+// Check of log_download against a scripted terminal on a pseudo-terminal.
+//
+//   log_download_test [--downloader PATH]
+//
+// Plays the terminal side of the log download (protocol.h) the way logPump() does:
+// records from the requested sequence number on, LOG_RECORDS_PER_FRAME to a frame, at
+// most a window past the last ACK, then FRAME_LOG_END. Each case starts log_download
+// (default: the one next to this binary) on the slave end and checks that its CSV
+// holds exactly the stored records from the requested one on, in order, once each:
+//   lost frame     one FRAME_LOG_DATA goes out with a bad CRC
+//   lost frames    two in a row, then one on the retransmission
+//   wrap           sequence numbers run 0xFFFE -> 0 (0xFFFF marks an empty slot)
+//   overwritten    the request starts before the oldest stored record
+// Exits non-zero if any case fails.
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "frame.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int TIMEOUT_MS = 200; // log_download --timeout; keeps the stall cases quick
+constexpr int CASE_LIMIT_MS = 10000;
+
+struct Case {
+    const char* name;
+    uint16_t firstStored;            // Sequence number of the oldest stored record
+    unsigned int stored;             // Records held by the terminal
+    uint16_t from;                   // log_download --from
+    std::set<unsigned int> corrupt;  // FRAME_LOG_DATA frames (0 = first sent) to send with a bad CRC
+};
+
+// The terminal's side of one download
+class FakeTerminal {
+public:
+    explicit FakeTerminal(const Case& c) : case_(c) {
+        uint16_t seq = c.firstStored;
+        for (unsigned int i = 0; i < c.stored; i++, seq = seqAfter(seq)) seqs_.push_back(seq);
+    }
+    const std::vector<uint16_t>& seqs() const { return seqs_; }
+
+    void onFrame(uint8_t type, const uint8_t* p, size_t len) {
+        if (type == FRAME_LOG_REQUEST && len == REQ_PAYLOAD_SIZE) {
+            active_ = true;
+            next_ = indexOf(le16(p + REQ_START_SEQ));
+            acked_ = next_;
+            window_ = p[REQ_WINDOW] ? p[REQ_WINDOW] : 16;
+        } else if (type == FRAME_LOG_ACK && len == ACK_PAYLOAD_SIZE) {
+            acked_ = indexOf(le16(p + ACK_NEXT_SEQ));
+        }
+    }
+
+    // Frames the window allows now, appended to 'out'
+    void pump(std::vector<uint8_t>& out) {
+        while (active_ && next_ < acked_ + window_) {
+            if (next_ >= seqs_.size()) {
+                uint8_t end[END_PAYLOAD_SIZE];
+                putLe16(end + END_NEXT_SEQ, seqAfter(seqs_.back()));
+                putLe16(end + END_OLDEST_SEQ, seqs_.front());
+                encodeFrame(out, FRAME_LOG_END, end, sizeof(end));
+                active_ = false;
+                return;
+            }
+            std::vector<uint8_t> payload;
+            for (unsigned int n = 0; n < LOG_RECORDS_PER_FRAME && next_ < seqs_.size() && next_ < acked_ + window_; n++) {
+                uint8_t rec[LOG_RECORD_SIZE] = {};
+                putLe16(rec + LOG_REC_SEQ, seqs_[next_]);
+                putLe16(rec + LOG_REC_ROLL, 2301 + next_ % 10);
+                rec[LOG_REC_DIRECTION] = next_ & 1;
+                putLe32(rec + LOG_REC_TIME, 846979200 + next_ * 60); // 2026-10-16 from midnight on
+                payload.insert(payload.end(), rec, rec + LOG_RECORD_SIZE);
+                next_++;
+            }
+            size_t start = out.size();
+            encodeFrame(out, FRAME_LOG_DATA, payload.data(), payload.size());
+            if (case_.corrupt.count(dataFrames_++)) out[start + 3] ^= 0x40; // Payload byte flipped on the line
+        }
+    }
+
+private:
+    // Index of the first stored record at or after 'seq' (as the terminal skips older ones)
+    size_t indexOf(uint16_t seq) const {
+        for (size_t i = 0; i < seqs_.size(); i++) {
+            if (static_cast<int16_t>(seqs_[i] - seq) >= 0) return i;
+        }
+        return seqs_.size();
+    }
+
+    const Case& case_;
+    std::vector<uint16_t> seqs_;
+    bool active_ = false;
+    size_t next_ = 0, acked_ = 0, window_ = 16;
+    unsigned int dataFrames_ = 0;
+};
+
+// Run log_download against the fake terminal. Returns its exit status; 'csv' gets its stdout.
+int runCase(const Case& c, const std::string& downloader, std::string& csv) {
+    FakeTerminal term(c);
+    termios raw{};
+    cfmakeraw(&raw);
+    int master, slave;
+    char name[64];
+    if (openpty(&master, &slave, name, &raw, nullptr) < 0) { std::perror("openpty"); return -1; }
+    int out[2];
+    if (pipe(out) < 0) { std::perror("pipe"); return -1; }
+
+    std::string from = std::to_string(c.from), timeout = std::to_string(TIMEOUT_MS);
+    pid_t child = fork();
+    if (child == 0) {
+        dup2(out[1], STDOUT_FILENO);
+        close(out[0]);
+        close(master);
+        std::vector<char*> args = {const_cast<char*>(downloader.c_str()), name, const_cast<char*>("--from"),
+                                   const_cast<char*>(from.c_str()), const_cast<char*>("--timeout"),
+                                   const_cast<char*>(timeout.c_str()), nullptr};
+        execv(downloader.c_str(), args.data());
+        std::perror(downloader.c_str());
+        _exit(127);
+    }
+    close(out[1]);
+    close(slave);
+
+    FrameParser parser;
+    std::vector<uint8_t> tx;
+    auto deadline = Clock::now() + std::chrono::milliseconds(CASE_LIMIT_MS);
+    bool outOpen = true;
+    while (outOpen && Clock::now() < deadline) {
+        pollfd pfd[2] = {{master, POLLIN, 0}, {out[0], POLLIN, 0}};
+        if (poll(pfd, 2, 50) < 0) break;
+        if (pfd[0].revents & POLLIN) {
+            uint8_t buf[512];
+            ssize_t n = read(master, buf, sizeof(buf));
+            if (n > 0) parser.feed(buf, static_cast<size_t>(n), [&](uint8_t type, const uint8_t* p, size_t len) { term.onFrame(type, p, len); });
+        }
+        if (pfd[1].revents & (POLLIN | POLLHUP)) {
+            char buf[4096];
+            ssize_t n = read(out[0], buf, sizeof(buf));
+            if (n <= 0) outOpen = false;
+            else csv.append(buf, static_cast<size_t>(n));
+        }
+        term.pump(tx);
+        if (!tx.empty() && write(master, tx.data(), tx.size()) > 0) tx.clear();
+    }
+    int status = 0;
+    if (outOpen) kill(child, SIGKILL);
+    waitpid(child, &status, 0);
+    close(out[0]);
+    close(master);
+    if (outOpen) return -2;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// The 'log' lines' sequence numbers must be the stored ones from the first wanted on
+bool checkCsv(const Case& c, const std::vector<uint16_t>& stored, const std::string& csv, std::string& why) {
+    std::vector<uint16_t> want;
+    for (uint16_t seq : stored) {
+        if (static_cast<int16_t>(seq - c.from) >= 0) want.push_back(seq);
+    }
+    std::vector<uint16_t> got;
+    for (size_t pos = 0; (pos = csv.find("\nlog,,", pos)) != std::string::npos; pos++) {
+        got.push_back(static_cast<uint16_t>(std::strtoul(csv.c_str() + pos + 6, nullptr, 10)));
+    }
+    for (size_t i = 0; i < want.size() || i < got.size(); i++) {
+        if (i >= got.size()) { why = "missing seq " + std::to_string(want[i]) + " on"; return false; }
+        if (i >= want.size()) { why = "extra seq " + std::to_string(got[i]); return false; }
+        if (got[i] != want[i]) {
+            why = "seq " + std::to_string(got[i]) + " where " + std::to_string(want[i]) + " belongs";
+            return false;
+        }
+    }
+    return true;
+}
+
+void usage(const char* argv0) { std::fprintf(stderr, "usage: %s [--downloader PATH]\n", argv0); }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string downloader = std::string(argv[0]).substr(0, std::string(argv[0]).find_last_of('/') + 1) + "log_download";
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) { usage(argv[0]); return 2; }
+        if (!std::strcmp(argv[i], "--downloader")) downloader = argv[++i];
+        else { usage(argv[0]); return 2; }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    const Case cases[] = {
+        {"lost frame", 0, 60, 0, {2}},
+        {"lost frames", 100, 60, 100, {1, 2, 4}},
+        {"wrap", 0xFFE0, 60, 0xFFE0, {3}},
+        {"overwritten", 40, 30, 20, {}},
+    };
+    int failures = 0;
+    for (const Case& c : cases) {
+        std::string csv, why;
+        int status = runCase(c, downloader, csv);
+        bool ok = status == 0 && checkCsv(c, FakeTerminal(c).seqs(), csv, why);
+        if (status == -2) why = "timed out";
+        else if (status != 0) why = "exit status " + std::to_string(status);
+        std::printf("%-12s %s%s%s\n", c.name, ok ? "ok" : "FAIL", ok ? "" : ": ", ok ? "" : why.c_str());
+        failures += !ok;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,260 @@
+// Load generator for occupancy_server: N simulated terminals on pseudo-terminals.
+//
+//   occupancy_load [--terminals N] [--events M] [--users U] [--dups PCT] [--queries Q]
+//                  [--server PATH]
+//
+// Opens N ptys and starts occupancy_server (default: the one next to this binary)
+// on their slave ends. It then writes M FRAME_EVENT frames spread over the terminals
+// as fast as the ptys take them. Every event flips a random one of U users in or
+// out at an increasing terminal clock, and the user can walk out through a different
+// door than the one they came in by. PCT percent of the frames are sent twice, as a
+// terminal repeating itself would. The tool waits until the server has taken every
+// frame and reports the ingest rate. It checks the server's presence table against
+// its own, then times Q 'count' and Q / 10 'who' round trips on the query socket.
+// Sequence numbers start just below the wrap and skip 0xFFFF as the terminal's do.
+// Exits non-zero if anything was lost, a gap was reported, or the tables differ.
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "frame.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Terminal {
+    int master = -1, slave = -1;
+    std::string path;        // Slave end, handed to the server
+    std::vector<uint8_t> stream;
+    size_t sent = 0;         // Bytes of stream written so far
+    uint16_t seq = 0xFF00;   // Near the wrap, so a run crosses 0xFFFE -> 0 as a terminal does
+};
+
+struct Expected {
+    unsigned long frames = 0, events = 0, duplicates = 0;
+    std::set<uint16_t> inside;
+};
+
+// The whole run, generated up front so the timed part only writes
+Expected generate(std::vector<Terminal>& terms, unsigned long events, unsigned int users, unsigned int dupPct) {
+    std::mt19937 rng(2301);
+    std::vector<uint32_t> since(users + 1, 0); // Entry time, 0 = out
+    uint32_t now = 846979200;                  // 2026-10-16 00:00:00, seconds since 2000-01-01
+    Expected exp;
+    uint8_t payload[EVENT_PAYLOAD_SIZE];
+    for (unsigned long i = 0; i < events; i++) {
+        Terminal& t = terms[rng() % terms.size()];
+        uint16_t roll = static_cast<uint16_t>(1 + rng() % users);
+        now += 1 + rng() % 3;
+        bool entry = since[roll] == 0;
+        payload[EVENT_TERMINAL] = static_cast<uint8_t>(&t - terms.data() + 1);
+        putLe16(payload + EVENT_SEQ, t.seq);
+        t.seq = seqAfter(t.seq);
+        putLe16(payload + EVENT_ROLL, roll);
+        payload[EVENT_DIRECTION] = entry;
+        putLe32(payload + EVENT_TIME, now);
+        putLe32(payload + EVENT_DURATION, entry ? 0 : now - since[roll]);
+        size_t start = t.stream.size();
+        encodeFrame(t.stream, FRAME_EVENT, payload, sizeof(payload));
+        exp.frames++;
+        if (rng() % 100 < dupPct) { // Same frame again
+            t.stream.insert(t.stream.end(), t.stream.begin() + static_cast<long>(start), t.stream.end());
+            exp.frames++;
+            exp.duplicates++;
+        }
+        since[roll] = entry ? now : 0;
+        if (entry) exp.inside.insert(roll);
+        else exp.inside.erase(roll);
+    }
+    exp.events = events;
+    return exp;
+}
+
+int connectSocket(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path.c_str());
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return fd;
+    ::close(fd);
+    return -1;
+}
+
+// One query round trip: the answer up to (not including) its terminating empty line
+std::string query(int fd, const char* line) {
+    std::string q = std::string(line) + "\n";
+    if (::write(fd, q.data(), q.size()) != static_cast<ssize_t>(q.size())) return "";
+    std::string answer;
+    char buf[65536];
+    while (answer.size() < 2 || answer.compare(answer.size() - 2, 2, "\n\n") != 0) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0) return "";
+        answer.append(buf, static_cast<size_t>(n));
+    }
+    answer.pop_back();
+    return answer;
+}
+
+unsigned long statValue(const std::string& stats, const char* name) {
+    size_t at = stats.find(std::string(name) + " ");
+    if (at != 0 && at != std::string::npos) at = stats.find(std::string("\n") + name + " ") + 1;
+    return at == std::string::npos ? 0 : std::strtoul(stats.c_str() + at + std::strlen(name) + 1, nullptr, 10);
+}
+
+// Write every terminal's stream, a pty buffer at a time, as fast as the server drains them
+bool pump(std::vector<Terminal>& terms) {
+    std::vector<pollfd> fds;
+    while (true) {
+        fds.clear();
+        for (Terminal& t : terms) {
+            if (t.sent < t.stream.size()) fds.push_back({t.master, POLLOUT, 0});
+        }
+        if (fds.empty()) return true;
+        if (poll(fds.data(), fds.size(), 5000) <= 0) { std::fprintf(stderr, "ptys stopped draining\n"); return false; }
+        for (Terminal& t : terms) {
+            if (t.sent == t.stream.size()) continue;
+            ssize_t n = ::write(t.master, t.stream.data() + t.sent, t.stream.size() - t.sent);
+            if (n > 0) t.sent += static_cast<size_t>(n);
+            else if (n < 0 && errno != EAGAIN && errno != EINTR) { std::perror(t.path.c_str()); return false; }
+        }
+    }
+}
+
+double percentileUs(std::vector<double>& us, double p) {
+    std::sort(us.begin(), us.end());
+    return us[std::min(us.size() - 1, static_cast<size_t>(p * static_cast<double>(us.size())))];
+}
+
+void timeQueries(int fd, const char* line, unsigned long count) {
+    if (!count) return;
+    std::vector<double> us;
+    size_t bytes = 0;
+    for (unsigned long i = 0; i < count; i++) {
+        auto start = Clock::now();
+        bytes = query(fd, line).size();
+        us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    double p50 = percentileUs(us, 0.50), p99 = percentileUs(us, 0.99);
+    std::printf("query %-5s x%lu: p50 %.1f us, p99 %.1f us, max %.1f us (%zu-byte answer)\n", line, count, p50, p99,
+                us.back(), bytes);
+}
+
+void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--terminals N] [--events M] [--users U] [--dups PCT] [--queries Q] [--server PATH]\n",
+                 argv0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    unsigned long terminals = 8, events = 200000, users = 2000, dupPct = 5, queries = 2000;
+    std::string server = std::string(argv[0]).substr(0, std::string(argv[0]).find_last_of('/') + 1) + "occupancy_server";
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) { usage(argv[0]); return 2; }
+        if (!std::strcmp(argv[i], "--terminals")) terminals = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--events")) events = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--users")) users = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--dups")) dupPct = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--queries")) queries = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "--server")) server = argv[++i];
+        else { usage(argv[0]); return 2; }
+    }
+    if (terminals < 1 || terminals > 255 || users < 1 || users > 9999 || dupPct > 100) {
+        std::fprintf(stderr, "need 1-255 terminals, 1-9999 users and a duplicate percentage of 0-100\n");
+        return 2;
+    }
+
+    std::vector<Terminal> terms(terminals);
+    termios raw{};
+    cfmakeraw(&raw);
+    for (Terminal& t : terms) {
+        char name[64];
+        if (openpty(&t.master, &t.slave, name, &raw, nullptr) < 0) { std::perror("openpty"); return 1; }
+        fcntl(t.master, F_SETFL, fcntl(t.master, F_GETFL) | O_NONBLOCK);
+        t.path = name;
+    }
+    Expected exp = generate(terms, events, static_cast<unsigned int>(users), static_cast<unsigned int>(dupPct));
+    size_t streamBytes = 0;
+    for (const Terminal& t : terms) streamBytes += t.stream.size();
+
+    std::string socketPath = "/tmp/occupancy_load." + std::to_string(getpid()) + ".sock";
+    pid_t child = fork();
+    if (child == 0) {
+        std::vector<char*> args{const_cast<char*>(server.c_str()), const_cast<char*>("--socket"),
+                                const_cast<char*>(socketPath.c_str())};
+        for (Terminal& t : terms) args.push_back(const_cast<char*>(t.path.c_str()));
+        args.push_back(nullptr);
+        execv(server.c_str(), args.data());
+        std::perror(server.c_str());
+        _exit(127);
+    }
+    int sock = -1;
+    for (int tries = 0; tries < 500 && sock < 0; tries++) { // The server opens the ptys before it listens
+        sock = connectSocket(socketPath);
+        if (sock < 0) usleep(10000);
+    }
+    int status = 1;
+    if (sock < 0) std::fprintf(stderr, "%s did not come up\n", server.c_str());
+    else {
+        auto start = Clock::now();
+        bool written = pump(terms);
+        std::string stats;
+        unsigned long taken = 0;
+        auto deadline = Clock::now() + std::chrono::seconds(10);
+        while (written && Clock::now() < deadline) { // The last bytes may still sit in the ptys
+            stats = query(sock, "stats");
+            taken = statValue(stats, "frames");
+            if (taken >= exp.frames) break;
+            usleep(200);
+        }
+        double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::printf("%lu terminals, %lu events + %lu duplicates, %zu bytes in %.3f s\n", terminals, exp.events,
+                    exp.duplicates, streamBytes, secs);
+        std::printf("ingest: %.0f frames/s, %.2f MB/s, %.1f frames per read\n", static_cast<double>(taken) / secs,
+                    static_cast<double>(statValue(stats, "bytes")) / secs / 1e6,
+                    static_cast<double>(taken) / static_cast<double>(std::max(1ul, statValue(stats, "reads"))));
+        std::printf("server: %lu events, %lu duplicates, %lu stale, %lu missed, %lu bad frames, %lu inside\n",
+                    statValue(stats, "events"), statValue(stats, "duplicates"), statValue(stats, "stale"),
+                    statValue(stats, "missed"), statValue(stats, "bad_frames"), statValue(stats, "inside"));
+
+        std::set<uint16_t> inside;
+        std::string who = query(sock, "who");
+        for (size_t at = who.find('\n') + 1; at < who.size(); at = who.find('\n', at) + 1) {
+            inside.insert(static_cast<uint16_t>(std::strtoul(who.c_str() + at, nullptr, 10)));
+        }
+        // Events overtaken on another door's stream are stale, not lost; nothing was skipped
+        bool match = statValue(stats, "events") + statValue(stats, "stale") == exp.events &&
+                     statValue(stats, "duplicates") == exp.duplicates && statValue(stats, "missed") == 0 &&
+                     inside == exp.inside;
+        std::printf("presence: %zu inside, %s\n", inside.size(), match ? "matches the generator" : "DIFFERS from the generator");
+
+        timeQueries(sock, "count", queries);
+        timeQueries(sock, "who", queries / 10);
+        ::close(sock);
+        status = match ? 0 : 1;
+    }
+    kill(child, SIGTERM);
+    waitpid(child, nullptr, 0);
+    return status;
+}
@@ -0,0 +1,348 @@
+// Central occupancy view for several door terminals.
+//
+//   occupancy_server --socket PATH [--verbose] DEVICE...
+//
+// Reads the FRAME_EVENT and FRAME_CHECKOUT frames (protocol.h) of every DEVICE (serial ports or ptys) on
+// one epoll loop, parsing a whole read() at a time, and keeps one presence table for
+// the site: a roll number is inside from its entry until its exit, whichever
+// terminals saw them. Events are deduplicated by (terminal ID, sequence number), so
+// a terminal wired to two ports, or one that resends, counts once. They are applied
+// in terminal-clock order per roll number, so a late event from a slow link cannot
+// undo a newer one (the terminal clocks are assumed to be kept in step).
+//
+// Queries are one text line each on the UNIX stream socket PATH. Every answer ends
+// with an empty line.
+//   count      people inside
+//   who        roll,terminal,since for everyone inside (since = terminal clock)
+//   roll N     N's line from 'who', or "N,out"
+//   stats      ingest counters
+// For example: printf 'who\n' | socat - UNIX-CONNECT:PATH
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "frame.h"
+
+namespace {
+
+#define MAX_ROLL 9999        // 4-digit keypad codes
+#define READ_CHUNK 65536     // Bytes per device read(); one read is one parse batch
+#define MAX_EPOLL_EVENTS 64
+#define MAX_QUERY_LINE 64    // A client sending a longer line is dropped
+
+volatile sig_atomic_t stopping = 0;
+
+void onSignal(int) { stopping = 1; }
+
+// Site-wide presence. people_ is indexed by roll number; inside_ holds the roll
+// numbers of everyone inside, densely, so 'who' costs the people inside only.
+class Presence {
+public:
+    enum Result { APPLIED, STALE, BAD_ROLL };
+
+    Result apply(uint8_t terminal, uint16_t roll, bool entry, uint32_t time) {
+        if (roll == 0 || roll > MAX_ROLL) return BAD_ROLL;
+        Person& p = people_[roll];
+        if (p.seen && time < p.time) return STALE; // Older than what we already applied
+        p.seen = true;
+        p.time = time;
+        p.terminal = terminal;
+        if (entry && p.slot < 0) {
+            p.slot = static_cast<int>(inside_.size());
+            inside_.push_back(roll);
+        } else if (!entry && p.slot >= 0) {
+            uint16_t last = inside_.back(); // Swap the last one into the gap
+            inside_[static_cast<size_t>(p.slot)] = last;
+            people_[last].slot = p.slot;
+            inside_.pop_back();
+            p.slot = -1;
+        }
+        return APPLIED;
+    }
+
+    size_t count() const { return inside_.size(); }
+    void appendWho(std::string& out) const {
+        out += "roll,terminal,since\n";
+        for (uint16_t roll : inside_) appendLine(out, roll);
+    }
+    void appendRoll(std::string& out, unsigned long roll) const {
+        if (roll >= 1 && roll <= MAX_ROLL && people_[roll].slot >= 0) appendLine(out, static_cast<uint16_t>(roll));
+        else out += std::to_string(roll) + ",out\n";
+    }
+
+private:
+    struct Person {
+        bool seen = false;
+        uint8_t terminal = 0; // Terminal of the latest applied event
+        uint32_t time = 0;    // Terminal clock of the latest applied event
+        int slot = -1;        // Index in inside_, -1 when out
+    };
+    void appendLine(std::string& out, uint16_t roll) const {
+        const Person& p = people_[roll];
+        out += std::to_string(roll) + "," + std::to_string(p.terminal) + "," + clockText(p.time) + "\n";
+    }
+    Person people_[MAX_ROLL + 1];
+    std::vector<uint16_t> inside_;
+};
+
+struct Stats {
+    unsigned long reads = 0, bytes = 0, frames = 0, events = 0;
+    unsigned long duplicates = 0, stale = 0, missed = 0, badRolls = 0, otherFrames = 0;
+};
+
+class Server {
+public:
+    bool open(const char* socketPath, const std::vector<const char*>& devices) {
+        epoll_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_ < 0) { std::perror("epoll_create1"); return false; }
+        for (const char* path : devices) {
+            if (!openDevice(path)) return false;
+        }
+
+        listen_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (std::strlen(socketPath) >= sizeof(addr.sun_path)) { std::fprintf(stderr, "%s: path too long\n", socketPath); return false; }
+        std::strcpy(addr.sun_path, socketPath);
+        ::unlink(socketPath); // A stale socket from an earlier run
+        if (listen_ < 0 || bind(listen_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_, 16) < 0) {
+            std::perror(socketPath);
+            return false;
+        }
+        socketPath_ = socketPath;
+        watch(listen_, EPOLLIN);
+        return true;
+    }
+
+    ~Server() {
+        if (!socketPath_.empty()) ::unlink(socketPath_.c_str());
+    }
+
+    void run(bool verbose) {
+        verbose_ = verbose;
+        epoll_event ready[MAX_EPOLL_EVENTS];
+        while (!stopping) {
+            int n = epoll_wait(epoll_, ready, MAX_EPOLL_EVENTS, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                std::perror("epoll_wait");
+                return;
+            }
+            for (int i = 0; i < n; i++) {
+                int fd = ready[i].data.fd;
+                if (fd == listen_) acceptClients();
+                else if (devices_.count(fd)) readDevice(fd);
+                else if (clients_.count(fd)) serviceClient(fd, ready[i].events);
+            }
+        }
+    }
+
+private:
+    struct Device {
+        std::string path;
+        FrameParser parser;
+    };
+    struct Terminal {
+        bool seen = false;
+        uint16_t nextSeq = 0; // Sequence number after the newest one applied
+    };
+    struct Client {
+        std::string in, out;
+    };
+
+    void watch(int fd, uint32_t events) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    bool openDevice(const char* path) {
+        int fd = ::open(path, O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) { std::perror(path); return false; }
+        termios tio{};
+        if (tcgetattr(fd, &tio) == 0) { // Not a tty (e.g. a FIFO): use as is
+            cfmakeraw(&tio);
+            cfsetispeed(&tio, B115200);
+            cfsetospeed(&tio, B115200);
+            tio.c_cflag |= CLOCAL | CREAD;
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+        devices_[fd].path = path;
+        watch(fd, EPOLLIN);
+        return true;
+    }
+
+    void readDevice(int fd) {
+        static uint8_t chunk[READ_CHUNK];
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+        Device& dev = devices_[fd];
+        if (n <= 0) { // Hung up (a pty whose other end closed, an unplugged adapter)
+            std::fprintf(stderr, "%s: %s, no longer read\n", dev.path.c_str(), n ? std::strerror(errno) : "end of file");
+            closedBadFrames_ += dev.parser.badFrames();
+            epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+            ::close(fd);
+            devices_.erase(fd);
+            return;
+        }
+        stats_.reads++;
+        stats_.bytes += static_cast<unsigned long>(n);
+        dev.parser.feed(chunk, static_cast<size_t>(n), [this](uint8_t type, const uint8_t* p, size_t len) {
+            stats_.frames++;
+            if (type == FRAME_EVENT && len == EVENT_PAYLOAD_SIZE) onEvent(p);
+            else if (type == FRAME_CHECKOUT && len > CHK_RECORDS && (len - CHK_RECORDS) % CHK_RECORD_SIZE == 0) onCheckout(p, len);
+            else stats_.otherFrames++; // Log downloads, totals answers: not this tool's business
+        });
+    }
+
+    void onEvent(const uint8_t* p) {
+        applyEvent(p[EVENT_TERMINAL], le16(p + EVENT_SEQ), le16(p + EVENT_ROLL), p[EVENT_DIRECTION] != 0,
+                   le32(p + EVENT_TIME));
+    }
+
+    // One exit per record, all at the checkout time, numbered on from the first
+    void onCheckout(const uint8_t* p, size_t len) {
+        uint16_t seq = le16(p + CHK_FIRST_SEQ);
+        for (size_t off = CHK_RECORDS; off < len; off += CHK_RECORD_SIZE, seq = seqAfter(seq)) {
+            applyEvent(p[CHK_TERMINAL], seq, le16(p + off + CHK_REC_ROLL), false, le32(p + CHK_TIME));
+        }
+    }
+
+    void applyEvent(uint8_t terminal, uint16_t seq, uint16_t roll, bool entry, uint32_t time) {
+        Terminal& t = terminals_[terminal];
+        if (t.seen && static_cast<int16_t>(seq - t.nextSeq) < 0) { stats_.duplicates++; return; }
+        if (t.seen) stats_.missed += seqDistance(t.nextSeq, seq); // Gap: lost on the line
+        t.seen = true;
+        t.nextSeq = seqAfter(seq);
+
+        switch (presence_.apply(terminal, roll, entry, time)) {
+        case Presence::APPLIED: stats_.events++; break;
+        case Presence::STALE: stats_.stale++; break;
+        case Presence::BAD_ROLL: stats_.badRolls++; break;
+        }
+        if (verbose_) std::printf("%u,%u,%u,%s,%s\n", terminal, seq, roll, entry ? "entry" : "exit", clockText(time).c_str());
+    }
+
+    void acceptClients() {
+        while (true) {
+            int fd = accept4(listen_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            clients_[fd];
+            watch(fd, EPOLLIN);
+        }
+    }
+
+    void dropClient(int fd) {
+        epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        clients_.erase(fd);
+    }
+
+    void serviceClient(int fd, uint32_t events) {
+        Client& c = clients_[fd];
+        if ((events & (EPOLLHUP | EPOLLERR)) && !(events & EPOLLIN)) { dropClient(fd); return; }
+        if (events & EPOLLIN) {
+            char buf[256];
+            ssize_t n = ::read(fd, buf, sizeof(buf));
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) { dropClient(fd); return; }
+            if (n > 0) c.in.append(buf, static_cast<size_t>(n));
+            for (size_t nl; (nl = c.in.find('\n')) != std::string::npos;) {
+                answer(c.in.substr(0, nl), c.out);
+                c.in.erase(0, nl + 1);
+            }
+            if (c.in.size() > MAX_QUERY_LINE) { dropClient(fd); return; }
+        }
+        flush(fd, c);
+    }
+
+    void answer(std::string line, std::string& out) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line == "count") out += std::to_string(presence_.count()) + "\n";
+        else if (line == "who") presence_.appendWho(out);
+        else if (line.compare(0, 5, "roll ") == 0) presence_.appendRoll(out, std::strtoul(line.c_str() + 5, nullptr, 10));
+        else if (line == "stats") {
+            char text[512];
+            std::snprintf(text, sizeof(text),
+                          "devices %zu\nreads %lu\nbytes %lu\nframes %lu\nevents %lu\nduplicates %lu\nstale %lu\n"
+                          "missed %lu\nbad_rolls %lu\nother_frames %lu\nbad_frames %lu\ninside %zu\n",
+                          devices_.size(), stats_.reads, stats_.bytes, stats_.frames, stats_.events, stats_.duplicates,
+                          stats_.stale, stats_.missed, stats_.badRolls, stats_.otherFrames, badFrames(), presence_.count());
+            out += text;
+        } else out += "unknown query; try count, who, roll N, stats\n";
+        out += "\n";
+    }
+
+    unsigned long badFrames() const {
+        unsigned long bad = closedBadFrames_;
+        for (const auto& d : devices_) bad += d.second.parser.badFrames();
+        return bad;
+    }
+
+    // Write what the socket takes; wait for EPOLLOUT only while a reply is backed up
+    void flush(int fd, Client& c) {
+        while (!c.out.empty()) {
+            ssize_t n = ::write(fd, c.out.data(), c.out.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && errno != EAGAIN) { dropClient(fd); return; }
+            if (n < 0) break;
+            c.out.erase(0, static_cast<size_t>(n));
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN | (c.out.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+        ev.data.fd = fd;
+        epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+    int epoll_ = -1, listen_ = -1;
+    std::string socketPath_;
+    bool verbose_ = false;
+    std::unordered_map<int, Device> devices_;
+    std::unordered_map<int, Client> clients_;
+    Terminal terminals_[256]; // By terminal ID
+    Presence presence_;
+    Stats stats_;
+    unsigned long closedBadFrames_ = 0;
+};
+
+void usage(const char* argv0) { std::fprintf(stderr, "usage: %s --socket PATH [--verbose] DEVICE...\n", argv0); }
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* socketPath = nullptr;
+    bool verbose = false;
+    std::vector<const char*> devices;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--socket") && i + 1 < argc) socketPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--verbose")) verbose = true;
+        else if (argv[i][0] == '-') { usage(argv[0]); return 2; }
+        else devices.push_back(argv[i]);
+    }
+    if (!socketPath || devices.empty()) { usage(argv[0]); return 2; }
+
+    struct sigaction sa{};
+    sa.sa_handler = onSignal; // No SA_RESTART: epoll_wait returns EINTR and the loop ends
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN); // A client that goes away mid-reply
+
+    static Server server; // people_ is 10000 entries: keep it off the stack
+    if (!server.open(socketPath, devices)) return 1;
+    std::fprintf(stderr, "reading %zu devices, queries on %s\n", devices.size(), socketPath);
+    server.run(verbose);
+    return 0;
+}
@@ -0,0 +1,72 @@
+// Roster CSV reader shared by the build tools (gen_users, dir_image).
+//
+// One "roll,name" line per user; blank lines, '#' comments and a header line are
+// skipped. Roll numbers are the 4-digit keypad codes 1-9999 (0 marks an empty
+// slot in the firmware's records). Names are 1-16 printable ASCII characters, a
+// whole LCD line. readRoster() returns the users sorted by roll number and fails
+// on anything malformed or duplicated, naming the line.
+#ifndef ROSTER_H
+#define ROSTER_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct RosterUser {
+    unsigned int id;
+    std::string name;
+    unsigned int line; // Line in the roster file (0 for generated users)
+};
+
+#define ROSTER_NAME_MAX 16
+
+inline bool sortRoster(std::vector<RosterUser>& users, const char* path) {
+    std::stable_sort(users.begin(), users.end(), [](const RosterUser& a, const RosterUser& b) { return a.id < b.id; });
+    for (size_t i = 1; i < users.size(); i++) {
+        if (users[i].id != users[i - 1].id) continue;
+        std::fprintf(stderr, "%s:%u: duplicate roll number %u (first on line %u)\n", path, users[i].line, users[i].id,
+                     users[i - 1].line);
+        return false;
+    }
+    return true;
+}
+
+inline bool readRoster(const char* path, std::vector<RosterUser>& users) {
+    std::ifstream in(path);
+    if (!in) { std::perror(path); return false; }
+    std::string line;
+    for (unsigned int lineNo = 1; std::getline(in, line); lineNo++) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        size_t comma = line.find(',');
+        char* end = nullptr;
+        unsigned long id = std::strtoul(line.c_str(), &end, 10);
+        if (comma == std::string::npos || comma == 0 || end != line.c_str() + comma) {
+            if (lineNo == 1) continue; // Header
+            std::fprintf(stderr, "%s:%u: expected roll,name\n", path, lineNo);
+            return false;
+        }
+        std::string name = line.substr(comma + 1);
+        if (id < 1 || id > 9999) {
+            std::fprintf(stderr, "%s:%u: roll number %lu is not a 4-digit keypad code (1-9999)\n", path, lineNo, id);
+            return false;
+        }
+        if (name.empty() || name.size() > ROSTER_NAME_MAX) {
+            std::fprintf(stderr, "%s:%u: name must be 1-%d characters\n", path, lineNo, ROSTER_NAME_MAX);
+            return false;
+        }
+        for (char c : name) {
+            if (c < ' ' || c > '~' || c == '"' || c == '\\') {
+                std::fprintf(stderr, "%s:%u: name has a character the LCD or the C table cannot take\n", path, lineNo);
+                return false;
+            }
+        }
+        users.push_back({static_cast<unsigned int>(id), name, lineNo});
+    }
+    return sortRoster(users, path);
+}
+
+#endif
@@ -0,0 +1,36 @@
+// Generated by tools/gen_users from roster.csv - do not edit, change the roster.
+// Included once, by attendence.c (program-memory directory).
+#define USER_COUNT 10
+#define USER_NAME_POOL_SIZE 61  // Name bytes, terminators included
+#define USER_LOOKUP_PROBES 4    // Worst-case binary search probes
+#define USER_NAME_BLOCK 8       // Users per userNameBlockAt entry
+#define USER_NAME_BLOCKS ((USER_COUNT + USER_NAME_BLOCK - 1) / USER_NAME_BLOCK)
+#define USER_TABLE_WORDS (USER_COUNT * 2 + USER_NAME_BLOCKS * 2 + USER_NAME_POOL_SIZE) // One RETLW per byte
+
+// Roll numbers, sorted ascending (macros, so the checks at the end read the same values)
+#define USER_ID_0 2301
+#define USER_ID_1 2302
+#define USER_ID_2 2303
+#define USER_ID_3 2304
+#define USER_ID_4 2305
+#define USER_ID_5 2306
+#define USER_ID_6 2307
+#define USER_ID_7 2308
+#define USER_ID_8 2309
+#define USER_ID_9 2310
+const unsigned int userIds[USER_COUNT] = {
+    USER_ID_0, USER_ID_1, USER_ID_2, USER_ID_3, USER_ID_4, USER_ID_5, USER_ID_6, USER_ID_7, USER_ID_8, USER_ID_9,
+};
+// Where the names of users i * USER_NAME_BLOCK on start in userNames
+const unsigned int userNameBlockAt[USER_NAME_BLOCKS] = {
+    0, 49,
+};
+// Names in userIds order, terminated and packed back to back
+const char userNames[USER_NAME_POOL_SIZE] =
+    "Aarav\0" "Diya\0" "Arjun\0" "Ananya\0" "Ishaan\0"
+    "Siya\0" "Vihaan\0" "Aanya\0" "Advait\0" "Avni\0";
+
+// Strictly ascending IDs: no duplicates, and the binary search holds
+typedef char users_sorted_0[(USER_ID_0 < USER_ID_1 && USER_ID_1 < USER_ID_2 && USER_ID_2 < USER_ID_3 && USER_ID_3 < USER_ID_4 && USER_ID_4 < USER_ID_5 && USER_ID_5 < USER_ID_6 && USER_ID_6 < USER_ID_7 && USER_ID_7 < USER_ID_8) ? 1 : -1];
+typedef char users_sorted_1[(USER_ID_8 < USER_ID_9) ? 1 : -1];
+typedef char users_fit_rom[(USER_TABLE_WORDS <= USER_TABLE_MAX_WORDS) ? 1 : -1];